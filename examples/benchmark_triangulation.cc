@@ -0,0 +1,92 @@
+/*
+  -------------------------------------------------------------------
+  
+  Copyright (C) 2010, Edwin van Leeuwen
+  
+  This file is part of RealTimePlot.
+  
+  RealTimePlot is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+  
+  RealTimePlot is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with RealTimePlot. If not, see <http://www.gnu.org/licenses/>.
+
+  -------------------------------------------------------------------
+*/
+
+/*
+ * Compares the different ways to triangulate a large set of points:
+ *
+ * benchmark_triangulation [no_points] [no_threads]
+ *
+ * Defaults to 1M points and all cores. Sequential insertion is skipped for 
+ * more than 10M points.
+ */
+#include <cstdlib>
+#include <iostream>
+#include "boost/date_time/posix_time/posix_time.hpp"
+
+#include "realtimeplot/delaunay.h"
+
+using namespace realtimeplot::delaunay;
+
+double seconds_since( const boost::posix_time::ptime &start ) {
+	return (boost::posix_time::microsec_clock::local_time() - start)
+		.total_microseconds()/1e6;
+}
+
+int main( int argc, char *argv[] ) {
+	size_t no_points = 1000000;
+	size_t no_threads = 0;
+	if (argc > 1)
+		no_points = atol( argv[1] );
+	if (argc > 2)
+		no_threads = atol( argv[2] );
+
+	std::vector<Vertex> points;
+	points.reserve( no_points );
+	for (size_t i=0; i<no_points; ++i)
+		points.push_back( Vertex( float(std::rand())/RAND_MAX,
+					float(std::rand())/RAND_MAX ) );
+	std::cout << no_points << " points" << std::endl;
+
+	boost::posix_time::ptime start;
+	if (no_points <= 10000000) {
+		Delaunay sequential = Delaunay( 0, 1, 0, 1 );
+		start = boost::posix_time::microsec_clock::local_time();
+		for (auto & p : points)
+			sequential.add_data( p );
+		std::cout << "add_data (one by one):  " << seconds_since( start ) 
+			<< "s" << std::endl;
+	}
+
+	{
+		Delaunay batch = Delaunay( 0, 1, 0, 1 );
+		start = boost::posix_time::microsec_clock::local_time();
+		batch.add_data( points );
+		std::cout << "add_data (batch):       " << seconds_since( start ) 
+			<< "s" << std::endl;
+	}
+
+	{
+		Delaunay single = Delaunay( 0, 1, 0, 1 );
+		start = boost::posix_time::microsec_clock::local_time();
+		single.triangulate( points, 1 );
+		std::cout << "triangulate (1 thread): " << seconds_since( start ) 
+			<< "s" << std::endl;
+	}
+
+	Delaunay parallel = Delaunay( 0, 1, 0, 1 );
+	start = boost::posix_time::microsec_clock::local_time();
+	parallel.triangulate( points, no_threads );
+	std::cout << "triangulate (parallel): " << seconds_since( start ) 
+		<< "s" << std::endl;
+	return 0;
+}
@@ -39,13 +39,16 @@ int main() {
 	float y = 2+2*float(std::rand())/RAND_MAX;
 	//std::cout << x << " " << y << " " << pow(((x-0.5)*(y-3)),2) << std::endl;
 	hm.add_data( x, y, pow(pow(((x-0.5)*(y-3)),2),0.5), true );
+	std::vector<float> levels;
+	levels.push_back( 0.05 );
+	levels.push_back( 0.1 );
+	levels.push_back( 0.2 );
+	hm.contours( levels );
 
 
 	// A regular grid, which can lead to numerical problems in delaunay algorithms.
-	// Our algorithm deals reasonably well with this case, but not perfectly.
-	// If you want to do this it is better/ideal to actually make the 
-	// grid slightly randomized, i.e. by adding small random values to each x/y 
-	// coordinate
+	// Our algorithm uses exact predicates, so it deals with this case correctly,
+	// but for data on a lattice GridHeightMap (below) is much faster.
 	HeightMap hm2 = HeightMap(0,1,0,1);
 
 	for (size_t i=0; i<50; ++i) {
@@ -60,10 +63,26 @@ int main() {
 			//sleep(1);
 		}
 	}
+
+	// The same lattice, without triangulation
+	GridHeightMap hm3 = GridHeightMap(0,1,0,1,50,50);
+	std::vector<float> zs;
+	for (size_t i=0; i<50; ++i) {
+		for (size_t j=0; j<50; ++j) {
+			float x = 1.0/49*i;
+			float y = 1.0/49*j;
+			zs.push_back( pow(pow(((x-0.5)*(y-0.5)),2),0.5) );
+		}
+	}
+	hm3.set_data( zs );
+	// Updating a single node only redraws the cells around it
+	hm3.add_data( 0.5, 0.5, 0.1 );
+
 	sleep(1);
 	//Optimize color distribution/usage
 	hm2.calculate_height_scaling();
 	hm.calculate_height_scaling();
+	hm3.calculate_height_scaling();
 
 	return 0;
 }
@@ -36,12 +36,20 @@ namespace realtimeplot {
 	class AdaptiveEventHandler : public EventHandler {
 		public:
 			bool adaptive;
+
+			/**
+			 * \brief Thin out the kept events instead of stopping when full
+			 *
+			 * See PlotConfig::keep_adapting
+			 */
+			bool keep_adapting;
 			/**
 			 * \brief Create AdaptiveEventHandler
 			 *
-			 * Optional parameter that defines the number of events to keep around
+			 * Optional parameters define the number of events to keep around and
+			 * whether the events are processed by the WorkerPool
 			 */
-			AdaptiveEventHandler( size_t no_events = 100 ); 
+			AdaptiveEventHandler( size_t no_events = 100, bool pooled = false ); 
 
 			/**
 			 * \brief Reprocess events in the processed_events list
@@ -50,15 +58,60 @@ namespace realtimeplot {
 			 */
 			virtual void reprocess();
 
+			/**
+			 * \brief Forget all kept events
+			 */
+			void clear_processed_events();
+
+			/**
+			 * \brief Change the number of events to keep
+			 *
+			 * Kept events are only dropped if they do not fit any more. They are
+			 * thinned out if keep_adapting is set, otherwise adapting stops.
+			 */
+			void set_max_no_events( size_t no_events );
+
+			/**
+			 * \brief Keep the event that is being processed for good
+			 *
+			 * Called when the event grew the plot region. It is kept even if it 
+			 * was thinned out and decimate will never drop it, so the replay still 
+			 * draws the outlier.
+			 */
+			void pin_current_event();
+
 
 			friend class ::TestAdaptive;
 			friend class BackendAdaptivePlot;
 		protected:
-			boost::mutex proc_mutex;
 			size_t max_no_events;
-			std::list<boost::shared_ptr<Event> > processed_events;
+			/**
+			 * \brief Kept events, in the order they were processed
+			 *
+			 * Room for max_no_events is reserved up front, so recording an event
+			 * never allocates. Only touched from the event processing thread.
+			 */
+			std::vector<boost::shared_ptr<Event> > processed_events;
+
+			//! Only every stride-th droppable event is kept
+			size_t stride;
+			//! Number of droppable events seen since the kept events were cleared
+			size_t no_droppable;
 
-			void process_events();
+			//! Event being executed, until it is pinned
+			boost::shared_ptr<Event> pCurrentEvent;
+			//! The event being executed is the last kept event
+			bool current_kept;
+
+			//! Keeps the event for replaying before executing it
+			void process_event( boost::shared_ptr<Event> pEvent );
+
+			/**
+			 * \brief Drop every other droppable event and double the stride
+			 *
+			 * Returns false if there was nothing to drop
+			 */
+			bool decimate();
 	};
 
 	/**
@@ -66,6 +119,11 @@ namespace realtimeplot {
 	 *
 	 * Works by keeping last x (default 100) events and whenever a new event
 	 * falls outside the current region -> Redraw the whole plot
+	 *
+	 * The region at least doubles in the direction of the new event, so n points
+	 * cause only O(log n) redraws. The redraw itself is postponed until the next
+	 * frame is due, such that a burst of points outside the region replays the 
+	 * kept events only once.
 	 */
 	class BackendAdaptivePlot : public BackendPlot {
 		public:
@@ -84,15 +142,41 @@ namespace realtimeplot {
 			void reset( PlotConfig conf );
 
 			/**
-			 * \brief Adapt the plot to the new x/y coords
+			 * \brief Does a pending redraw before displaying
+			 */
+			void display();
+
+			using BackendPlot::save;
+			void save( std::string fn );
+			void save_async( std::string fn, SaveCallback callback = SaveCallback() );
+
+			/**
+			 * \brief Grow the plot region to include the data
+			 *
+			 * Sides that the data crossed are moved out by at least the current 
+			 * range. Does not redraw.
+			 */
+			void grow();
+
+			/**
+			 * \brief Do a pending redraw now
 			 */
-			void adapt();
+			void flush();
 			friend class ::TestAdaptive;
 		private:
 			double max_data_x, max_data_y, min_data_x, min_data_y;
 
 			bool adapting;
 
+			//! Config changed, but the kept events are not redrawn yet
+			bool replay_pending;
+			boost::posix_time::ptime time_of_last_replay;
+
+			/**
+			 * \brief Reset the plot areas to the current config and replay the events
+			 */
+			void redraw();
+
 			/**
 			 * \brief Convenience method to convert EventHandler 
 			 * 	pointer to AdaptiveEventHandler
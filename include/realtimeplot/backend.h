@@ -25,6 +25,8 @@
 #define REALTIMEPLOT_BACKEND_H
 
 #include <vector>
+#include <deque>
+#include <stdint.h>
 #include <boost/thread/mutex.hpp>
 
 // Needs to be before cairomm, due to Xlib.h macros
@@ -41,6 +43,7 @@
 #include "realtimeplot/delaunay.h"
 #include "realtimeplot/xcbhandler.h"
 #include "realtimeplot/plotarea.h"
+#include "realtimeplot/utils.h"
 
 class TestBackend;
 
@@ -67,6 +70,9 @@ namespace realtimeplot {
 
 			int x_surface_width, x_surface_height;
 
+			//size of the last shown frame (0 until a frame is shown)
+			int frame_width, frame_height;
+
 			//config class, that keeps track op min_x etc
 			PlotConfig config;
 
@@ -81,6 +87,10 @@ namespace realtimeplot {
 
 			//set a flag when display shouldn't be updated (plotting still runs on)
 			bool pause_display;
+
+			//! Every shown frame is also saved as png (see record)
+			bool recording;
+			size_t no_recorded_frames;
 			/*
 			 * Methods
 			 */
@@ -96,7 +106,24 @@ namespace realtimeplot {
 			void draw_axes_surface();
 
 			//display the surface on xlib surface
-			void display();
+			virtual void display();
+
+			/**
+			 * \brief Show a part of the last shown frame again
+			 *
+			 * Used to repair exposed parts of the window, without composing a new 
+			 * frame. Falls back to display() if nothing was shown yet, or if the 
+			 * last frame does not have the current size.
+			 */
+			void display_region( int x, int y, int width, int height );
+
+			/**
+			 * \brief Is it time to show a new frame?
+			 *
+			 * True when the event queue is empty or more than half a second has
+			 * passed since the given time
+			 */
+			bool frame_due( const boost::posix_time::ptime &since );
 
 			//clears the plot
 			virtual void clear();
@@ -174,9 +201,38 @@ namespace realtimeplot {
 			void rectangle( float min_x, float min_y, float width_x, float width_y, 
 					bool fill = true, Color color = Color::black() );
 
-			void save( std::string fn );
+			/**
+			 * \brief Draw a grid of no_x by no_y cells in one operation
+			 *
+			 * Colors are premultiplied ARGB32 values, with the color of cell (x,y) stored
+			 * at colors[x*no_y+y]. The cells are put into an image which is painted 
+			 * scaled (without smoothing) with its lower left corner at min_x, min_y.
+			 */
+			void grid( float min_x, float min_y, float width_x, float width_y,
+					size_t no_x, size_t no_y, const std::vector<uint32_t> &colors );
+
+			virtual void save( std::string fn );
 			void save( std::string fn, Cairo::RefPtr<Cairo::ImageSurface> pSurface );
 
+			/**
+			 * \brief Save the plot as png without waiting for the encoding
+			 *
+			 * The plot is composed into a private image on this thread, which is
+			 * then encoded and written by the PngWriter threads. The callback is 
+			 * called from a writer thread once the file is written.
+			 */
+			virtual void save_async( std::string fn, 
+					SaveCallback callback = SaveCallback() );
+
+			/**
+			 * \brief Start or stop saving the shown frames as png files
+			 *
+			 * Frames are written to realtimeplot_00000.png, realtimeplot_00001.png,
+			 * etc. in the background. Frames are skipped when the writers can not 
+			 * keep up, so plotting is never slowed down by more than a copy.
+			 */
+			void record( bool on );
+
 			//Moved to xcbhandler
 			//void handle_xevent( xcb_generic_event_t *e );
 
@@ -287,9 +343,24 @@ namespace realtimeplot {
 			friend class ::TestBackend;
 		private:
 			DisplayHandler *pDisplayHandler;
+			//! Owns the display handler if frames are streamed to PlotConfig::frame_sink
+			boost::shared_ptr<FrameSinkHandler> pFrameSink;
 			size_t win;
 
 			Cairo::RefPtr<Cairo::ImageSurface> create_temporary_surface();
+
+			/**
+			 * \brief Draw the plot and axes onto surface (of the size of the axes)
+			 */
+			void compose( Cairo::RefPtr<Cairo::ImageSurface> surface );
+
+			//! Copy of a composed frame, to be handed to the PngWriter
+			boost::shared_ptr<PngImage> snapshot( 
+					Cairo::RefPtr<Cairo::ImageSurface> frame );
+			//! Queue the shown frame as the next recorded png
+			void record_frame( Cairo::RefPtr<Cairo::ImageSurface> frame );
+			//! Images of this plot that the PngWriter has not written yet
+			boost::shared_ptr<PngJobCounter> pPngJobs;
 			
 			static boost::mutex global_mutex;
 
@@ -297,36 +368,6 @@ namespace realtimeplot {
 			void checkConfig();
 	};
 
-
-	/**
-	 * \brief 3D Triangle for use in HeightMap
-	 */
-	class Vertex3D : public delaunay::Vertex
-	{
-		public:
-			float z;
-			Vertex3D( float x, float y, float z ) : 
-				delaunay::Vertex( x, y ), z(z) {}
-			boost::shared_ptr<Vertex3D> crossProduct( boost::shared_ptr<Vertex3D> pV ) {
-				return boost::shared_ptr<Vertex3D>( new Vertex3D( y*pV->z-z*pV->y, 
-							z*pV->x-x*pV->z, x*pV->y-y*pV->x ) );
-			}
-	};
-
-	class Triangle3D 
-	{
-		public:
-			Triangle3D() {};
-			Triangle3D( boost::shared_ptr<delaunay::Triangle> pTriangle ) {
-				for (size_t i=0; i<3; ++i) {
-					vertices.push_back( boost::static_pointer_cast<Vertex3D, delaunay::Vertex>(
-								pTriangle->corners[i]->vertex ) );
-				}
-			}
-
-			std::vector<boost::shared_ptr<Vertex3D> > gradientVector();
-			std::vector<boost::shared_ptr<Vertex3D> > vertices;
-	};
 	/**
 	 * \brief Provides backend functions specific for Histogram
 	 */
@@ -342,7 +383,27 @@ namespace realtimeplot {
 
 			double data_min, data_max;
 
+			//! Total counts per bin (summed over all series)
 			std::vector<double> bins_y;
+
+			//! Series id of each data point
+			std::vector<size_t> data_series;
+			size_t no_series;
+			//! Counts per series, series s is stored at [s*no_bins, (s+1)*no_bins)
+			std::vector<double> series_bins;
+			//! Number of data points per series
+			std::vector<double> series_size;
+			//! Stack the series on top of each other, instead of overlaying them
+			bool stacked;
+
+			//! If true only recent data is shown, see sliding_window/decaying_window
+			bool windowed;
+			//! Measure the window in seconds instead of number of samples
+			bool window_in_seconds;
+			size_t no_samples_seen;
+			boost::posix_time::ptime window_start;
+			utils::WindowedBins window;
+
 			/**
 			 * \brief Creates a histogram
 			 *
@@ -359,8 +420,16 @@ namespace realtimeplot {
 
 			/**
 			 * \brief Add a new measurement/data
+			 *
+			 * All series share the same bins. Each series is drawn in 
+			 * Color::by_id(series).
 			 */
-			void add_data( double data );
+			void add_data( double data, size_t series = 0 );
+
+			/**
+			 * \brief Make sure series ids up to no_series-1 can be used
+			 */
+			void add_series( size_t no_series );
 
 			/**
 			 * \brief Optimize bounds based on current added data
@@ -373,8 +442,44 @@ namespace realtimeplot {
 
 			void rebin_data();
 
+			/**
+			 * \brief Only show the last length samples (or seconds)
+			 *
+			 * The window is kept as a ring of no_slices sub histograms, so the
+			 * oldest data is forgotten in steps of length/no_slices.
+			 *
+			 * The bin edges are frozen when the window is started: either the
+			 * fixed plot area or the range covering the data added so far. Data
+			 * already added is moved into the window and no data is stored
+			 * anymore, so memory use is constant. A length that is not positive
+			 * is ignored.
+			 */
+			void sliding_window( double length, size_t no_slices, bool in_seconds );
+
+			/**
+			 * \brief Exponentially forget older data
+			 *
+			 * Weights halve every half_life samples (or seconds), applied in
+			 * no_steps steps per half life. Bin edges are frozen as for
+			 * sliding_window. A half_life that is not positive is ignored.
+			 */
+			void decaying_window( double half_life, size_t no_steps, bool in_seconds );
+
+			//! Current time as used by the window
+			double window_clock();
+
 			void plot();
 
+		protected:
+			void start_window();
+
+			/**
+			 * \brief Bin all data in one pass, filling bins_y and series_bins
+			 */
+			void bin_data();
+
+			//! Set config.max_y to fit the given counts
+			void update_max_y( const std::vector<double> &counts );
 		};
 
 	/**
@@ -446,8 +551,37 @@ namespace realtimeplot {
 			 */
 			void add_data( float x, float y, float z, bool show );
 
+			/**
+			 * \brief Adds a batch of points to the existing map
+			 *
+			 * The points are triangulated in a spatially sorted order (see 
+			 * delaunay::insertionOrder) and the map is drawn once afterwards
+			 */
+			void set_data( const std::vector<float> &xs, const std::vector<float> &ys,
+					const std::vector<float> &zs, bool show );
+
+			/**
+			 * \brief Only keep the most recent points
+			 *
+			 * Once there are more than max_points points, or a point is older than
+			 * max_age seconds, the oldest points are removed from the map (0 means 
+			 * no limit). Points already in the map expire first, checked whenever
+			 * new data is added.
+			 */
+			void sliding_window( size_t max_points, double max_age );
+
 			void plot();
 
+			/**
+			 * \brief Only redraw the part changed since the last (full) plot
+			 *
+			 * The bounding box of the changed triangles (and removed vertices) is
+			 * cleared and all triangles overlapping it are shaded again. Falls back
+			 * to plot() if data was added without showing it, or if the cached 
+			 * contours are out of date.
+			 */
+			void plot_changed();
+
 			/**
 			 * \brief Tries to calculate ideal scaling of the height parameter
 			 *
@@ -455,15 +589,128 @@ namespace realtimeplot {
 			 * of the data is
 			 */
 			void calculate_height_scaling();
+
+			/**
+			 * \brief Draw contour lines at the given heights on top of the map
+			 *
+			 * The lines are extracted from the triangulation (marching triangles) and
+			 * cached per level. After new data only the changed triangles are 
+			 * extracted again. Without levels no contours are drawn.
+			 */
+			void contours( const std::vector<float> &levels, Color color );
+			friend class ::TestBackend;
 		private:
+			//! Shade the triangles (skipping those that are part of the super triangle)
+			void draw_triangles( const std::vector<uint32_t> &triangles );
+
+			//! Update the cached contour segments crossing the triangles
+			void extract_contours( const std::vector<uint32_t> &triangles );
+
+			//! Stroke the contours crossing the triangles, one path per level
+			void draw_contours( const std::vector<uint32_t> &triangles );
+
+			//! Grow the dirty box to include the vertex
+			void mark_dirty( const delaunay::Vertex &vertex );
+			//! Make the dirty box empty
+			void clear_dirty();
+
+			/**
+			 * \brief Triangles of the data overlapping the dirty box
+			 *
+			 * The triangles overlapping a box form a connected part of the map, so 
+			 * they are found by walking outwards from the changed triangles.
+			 */
+			std::vector<uint32_t> triangles_in_dirty_box( 
+					const std::vector<uint32_t> &changed );
+
+			//! Bounding box (plot units) of the part that needs to be shaded again
+			delaunay::Vertex dirty_min, dirty_max;
+			//! Triangles visited by triangles_in_dirty_box, kept all false between calls
+			std::vector<bool> visited;
+			//! Data changed while hidden, so the next shown update redraws everything
+			bool needs_full_redraw;
+
+			std::vector<float> contour_levels;
+			//! Per level the end points of the segment crossing each triangle (NaN if none)
+			std::vector<std::vector<delaunay::Vertex> > contour_segments;
+			//! False when triangles changed without updating the segments
+			bool contours_valid;
+			Color contour_color;
+
+			//! Add the vertex to the window, unless it is already part of it
+			void window_add( uint32_t v );
+
+			/**
+			 * \brief Remove the points that fall outside of the window
+			 *
+			 * Returns true if zmin or zmax changed, so the whole map needs to be
+			 * shaded again.
+			 */
+			bool expire();
+
+			size_t window_max_points;
+			double window_max_age;
+			//! Vertices in the order they were added, with the time they were added
+			std::deque<std::pair<uint32_t, boost::posix_time::ptime> > window;
+			std::vector<bool> in_window;
+
 			float zmin, zmax;
 			delaunay::Delaunay delaunay;
+			//! Height of each vertex in delaunay (0 for the super triangle)
+			std::vector<float> heights;
 
 			ColorMap color_map;
-
-			inline Color colorMap( float z );
 	};
 
+	/**
+	 * \brief Provides backend functions specific for GridHeightMap plots
+	 *
+	 * Heights are kept on a regular lattice and drawn with bilinear interpolation,
+	 * so no triangulation is needed.
+	 */
+	class BackendGridHeightMap : public BackendPlot {
+		public:
+			BackendGridHeightMap( PlotConfig config, 
+					boost::shared_ptr<EventHandler> pEventHandler,
+					size_t no_x, size_t no_y );
+
+			/**
+			 * \brief Set the height of the lattice node closest to (x, y)
+			 *
+			 * Only the cells around that node are drawn again, unless the range of
+			 * heights changes. Hidden changes are drawn by the next shown update.
+			 */
+			void add_data( float x, float y, float z, bool show );
+
+			//! Replace all heights, indexed by [x*no_y+y]
+			void set_data( const std::vector<float> &zs, bool show );
+
+			void plot();
+
+			//! See BackendHeightMap::calculate_height_scaling
+			void calculate_height_scaling();
+
+			size_t no_x, no_y;
+			std::vector<float> zs;
+			friend class ::TestBackend;
+		private:
+			float zmin, zmax;
+			float width_x, width_y;
+			bool has_data;
+
+			//! Range of heights changed while hidden, so everything needs drawing
+			bool needs_full_redraw;
+			//! Nodes whose cells changed while hidden (empty if first > last)
+			size_t dirty_first_x, dirty_last_x, dirty_first_y, dirty_last_y;
+			//! Make the range of dirty nodes empty
+			void clear_dirty();
+
+			ColorMap color_map;
+
+			//! Draw the cells between nodes first_x..last_x and first_y..last_y
+			void draw_cells( size_t first_x, size_t last_x, 
+					size_t first_y, size_t last_y );
+	};
 }
 #endif
 
@@ -25,7 +25,8 @@
 #include <iostream>
 #include <ostream>
 #include <vector>
-#include <boost/shared_ptr.hpp>
+#include <limits>
+#include <stdint.h>
 
 class TestDelaunay;
 
@@ -34,102 +35,206 @@ namespace realtimeplot {
 		/*
 		 * This implementation follows the "corner method" as described in:
 		 * Venkates and Lee, An improved incremental Delaunay Triangulation Algorithm
+		 *
+		 * All data is kept in flat arrays addressed by 32 bit indices (a corner table).
+		 * Corners 3*t, 3*t+1 and 3*t+2 belong to triangle t, so next and previous 
+		 * corners and the triangle of a corner follow from its index.
 		 */
 		class Vertex {
 			public:
 				float x, y;
+				Vertex() : x(0), y(0) {}
 				Vertex( float x, float y ) :
 					x(x), y(y)
 			{}
-				bool operator==( Vertex &v ) {
+				bool operator==( const Vertex &v ) const {
 					if (x == v.x && y == v.y)
 						return true;
 					else
 						return false;
 				}
 
-				Vertex scalar( float s ) {
+				Vertex scalar( float s ) const {
 					Vertex v = Vertex( s*x, s*y );
 					return v;
 				}
 
-				Vertex operator+( Vertex v ) {
+				Vertex operator+( const Vertex &v ) const {
 					return Vertex( x+v.x, y+v.y );
 				}
-				Vertex operator-( Vertex &v ) {
+				Vertex operator-( const Vertex &v ) const {
 					return Vertex( x-v.x, y-v.y );
 				}
-				float dot(Vertex &v) {
+				float dot( const Vertex &v ) const {
 					return x*v.x+y*v.y;
 				}
 		};
 
+		//! Index used when a corner has no opposite corner
+		const uint32_t noCorner = std::numeric_limits<uint32_t>::max();
+
+		/**
+		 * \brief Orientation of c relative to the line a->b
+		 *
+		 * Positive if a, b, c are in counterclockwise order, negative if 
+		 * clockwise and zero if collinear (twice the signed area of abc).
+		 *
+		 * The sign is always exact: the determinant is evaluated in double and
+		 * only if it is smaller than its error bound it is recomputed in exact 
+		 * rational arithmetic (then only the sign, +-1, is returned).
+		 */
+		double orient2d( const Vertex &a, const Vertex &b, const Vertex &c );
+
+		/**
+		 * \brief Position of d relative to the circle through a, b and c
+		 *
+		 * For counterclockwise a, b, c: positive if d lies inside the circle, 
+		 * negative if outside and zero if on it. Sign is exact, see orient2d
+		 */
+		double incircle( const Vertex &a, const Vertex &b, const Vertex &c,
+				const Vertex &d );
+
+		//! Position of (x, y) along a Hilbert curve filling a 2^16 by 2^16 grid
+		uint64_t hilbertIndex( uint32_t x, uint32_t y );
+
+		/**
+		 * \brief Order in which to insert a batch of vertices
+		 *
+		 * Biased randomized insertion order (BRIO): the vertices are shuffled and 
+		 * split into rounds that double in size, within each round they are sorted 
+		 * along a Hilbert curve. Consecutive vertices are close together, which
+		 * keeps the walks in findTriangle short, while the rounds keep the good 
+		 * expected behaviour of a random insertion order.
+		 */
+		std::vector<uint32_t> insertionOrder( const std::vector<Vertex> &vertices );
+
 		class Edge {
 			public:
-				boost::shared_ptr<Vertex> pV0;
-				boost::shared_ptr<Vertex> pV1;
-				Edge( boost::shared_ptr<Vertex> pv0, boost::shared_ptr<Vertex> pv1 ) {
-					if (pv0->x <= pv1->x) {
-						pV0 = pv0;
-						pV1 = pv1;
+				Vertex v0;
+				Vertex v1;
+				Edge( const Vertex &vertex0, const Vertex &vertex1 ) {
+					if (vertex0.x <= vertex1.x) {
+						v0 = vertex0;
+						v1 = vertex1;
 					} else {
-						pV0 = pv1;
-						pV1 = pv0;
+						v0 = vertex1;
+						v1 = vertex0;
 					}
 				}
-				bool intersect( Edge& e );
-				bool include( Vertex &v );
-				Vertex intersectionVertex( Edge& e );
+				bool intersect( const Edge& e ) const;
+				bool include( const Vertex &v ) const;
+				Vertex intersectionVertex( const Edge& e ) const;
 		};
 
-		class Corner;
+		/**
+		 * \brief Geometry of a single triangle
+		 *
+		 * Holds copies of the vertices, so it can be created cheaply on the stack
+		 */
 		class Triangle {
 			public:
-				std::vector<boost::shared_ptr<Corner> > corners;
+				Vertex vertices[3];
+
+				Triangle() {}
+				Triangle( const Vertex &v0, const Vertex &v1, const Vertex &v2 ) {
+					vertices[0] = v0;
+					vertices[1] = v1;
+					vertices[2] = v2;
+				}
 
 				/**
 				 * \brief Check if the point is in this triangle
 				 */
-				bool inTriangle( boost::shared_ptr<Vertex> pV );
+				bool inTriangle( const Vertex &v ) const;
 
-				bool inCircumCircle( boost::shared_ptr<Vertex> pV ); 
+				bool inCircumCircle( const Vertex &v ) const; 
 
 				/**
 				 * \brief Returns a vertex corresponding to the center of the triangle
 				 */
-				Vertex center();
+				Vertex center() const;
 			protected:
 				/**
 				 * \brief Returns a vertex corresponding to the center of the triangle given two edges
 				 *
 				 * Intermediate method, introduced to minimize code duplication
 				 */
-				Vertex centerGivenTwoEdges( Vertex &v1, Vertex &v2 );
+				Vertex centerGivenTwoEdges( const Vertex &v1, const Vertex &v2 ) const;
 			};
 
-		class Corner {
-			public:
-				boost::shared_ptr<Vertex> vertex;
-				boost::shared_ptr<Corner> next;
-				boost::shared_ptr<Corner> previous;
-				boost::shared_ptr<Corner> opposite;
-				boost::shared_ptr<Triangle> triangle;
-				Corner() {};
-		};
-
 		class Delaunay {
 			public:
-				Delaunay() {};
+				Delaunay() : lastTriangle( 0 ) {};
 				Delaunay( float xmin, float xmax, float ymin, float ymax );
 
-				void add_data( boost::shared_ptr<Vertex> vertex );
+				/**
+				 * \brief Add a vertex to the triangulation
+				 *
+				 * Returns the index of the vertex in vertices. The first three vertices
+				 * belong to the super triangle. If the vertex is already part of the
+				 * triangulation nothing is added and the index of the existing vertex 
+				 * is returned.
+				 */
+				uint32_t add_data( const Vertex &vertex );
 
-				boost::shared_ptr<Triangle>
-					findTriangle( boost::shared_ptr<Vertex> vertex,
-						boost::shared_ptr<Triangle> tr );
+				/**
+				 * \brief Add a batch of vertices, inserted in insertionOrder
+				 *
+				 * Returns the index in vertices of each of the given vertices (in the
+				 * order they were given)
+				 */
+				std::vector<uint32_t> add_data( const std::vector<Vertex> &batch );
 
-				void createNewTriangles( boost::shared_ptr<Vertex> vertex,
-						boost::shared_ptr<Triangle> triangle );
+				/**
+				 * \brief Replace the triangulation by that of the given vertices
+				 *
+				 * Divide and conquer (Guibas and Stolfi): the vertices are sorted, both
+				 * halves are triangulated recursively and the seam between them is 
+				 * stitched together. The top levels of the recursion run on no_threads 
+				 * threads (0 uses all cores). Faster than add_data when all points are
+				 * known up front and more than one core is available. On a single core
+				 * incremental insertion wins.
+				 *
+				 * The super triangle is kept. Returns the index in vertices of each of 
+				 * the given vertices, like add_data
+				 */
+				std::vector<uint32_t> triangulate( const std::vector<Vertex> &points,
+						size_t no_threads = 0 );
+
+				/**
+				 * \brief Remove vertex v from the triangulation
+				 *
+				 * The hole is filled with the Delaunay triangulation of its neighbours.
+				 * The freed vertex index and triangles are reused by later insertions.
+				 */
+				void remove_data( uint32_t v );
+
+				/**
+				 * \brief Find the triangle that contains vertex
+				 *
+				 * Starts from the seed triangle of the grid cell the vertex falls in,
+				 * or from the last triangle created if that cell is still empty
+				 */
+				uint32_t findTriangle( const Vertex &vertex ) const;
+
+				/**
+				 * \brief Find the triangle that contains vertex, starting from triangle tr
+				 *
+				 * Visibility walk: moves to the neighbour across the first edge that
+				 * has the vertex on its outside, until no such edge is left. The edge 
+				 * tested first rotates every step, so the walk can not cycle.
+				 */
+				uint32_t findTriangle( const Vertex &vertex, uint32_t tr ) const;
+
+				/**
+				 * \brief Split triangle into three triangles around the new vertex
+				 *
+				 * If the vertex lies on an (internal) edge of the triangle, the edge 
+				 * is split instead and both triangles sharing it are split in two.
+				 *
+				 * Returns the index of the new vertex
+				 */
+				uint32_t createNewTriangles( const Vertex &vertex, uint32_t triangle );
 
 				/**
 				 * \brief Method that checks if edges need to be flipped and then flips them
@@ -137,17 +242,84 @@ namespace realtimeplot {
 				 * Method is recursive, so that new created triangles cause the method
 				 * to be called again
 				 *
-				 * pC is the new vertex, so we only check if the pC->opposite is inside
+				 * c is the corner of the new vertex, so we only check if its opposite is inside
 				 * the circumCircle. See "An improved incremental Delaunay Triangulation
 				 * Algorithm for details".
 				 *
-				 * The count is there to help detecting infinite loops (caused by numerical
-				 * inprecision
+				 * Terminates because the predicates are exact
 				 */
-				void flipEdgesRecursively( boost::shared_ptr<Corner> pC, size_t count = 0 );
-				std::vector<boost::shared_ptr<Vertex> > vertices;
-				std::vector<boost::shared_ptr<Triangle> > triangles;
-				std::vector<boost::shared_ptr<Corner> > corners;
+				void flipEdgesRecursively( uint32_t c );
+
+				/**
+				 * \brief Where the contour line at level crosses triangle t (marching triangles)
+				 *
+				 * Vertices with a height of at least level count as lying above it. 
+				 * Returns false if the line does not cross the triangle. Neighbouring 
+				 * triangles give exactly the same point on the edge they share.
+				 */
+				bool contourSegment( uint32_t t, const std::vector<float> &heights,
+						float level, Vertex &from, Vertex &to ) const;
+
+				/**
+				 * \brief Number of triangle slots
+				 *
+				 * Includes the ones using super triangle vertices and deleted ones
+				 */
+				size_t noTriangles() const {
+					return corners.size()/3;
+				}
+
+				//! Number of vertices in the triangulation (including the super triangle)
+				size_t noVertices() const {
+					return vertices.size()-freeVertices.size();
+				}
+
+				//! Triangle slot t is currently unused
+				bool isDeleted( uint32_t t ) const {
+					return corners[3*t] == noCorner;
+				}
+
+				//! Triangle the corner belongs to
+				static uint32_t triangle( uint32_t c ) {
+					return c/3;
+				}
+
+				static uint32_t next( uint32_t c ) {
+					return (c%3 == 2) ? c-2 : c+1;
+				}
+
+				static uint32_t previous( uint32_t c ) {
+					return (c%3 == 0) ? c+2 : c-1;
+				}
+
+				//! Vertex of a corner
+				const Vertex &vertex( uint32_t c ) const {
+					return vertices[corners[c]];
+				}
+
+				//! Geometry of triangle t
+				Triangle getTriangle( uint32_t t ) const {
+					return Triangle( vertex( 3*t ), vertex( 3*t+1 ), vertex( 3*t+2 ) );
+				}
+
+				std::vector<Vertex> vertices;
+				//! Vertex index of every corner
+				std::vector<uint32_t> corners;
+				//! Opposite corner of every corner (noCorner if it lies on the hull)
+				std::vector<uint32_t> opposites;
+
+				/**
+				 * \brief Triangles created or changed since this was last cleared
+				 *
+				 * Can contain duplicates and triangles that were deleted later on. Used 
+				 * to only redraw the part of a plot that changed, the user of the class 
+				 * is responsible for clearing it.
+				 */
+				std::vector<uint32_t> changedTriangles;
+
+				//! Unused vertex indices and triangles, left behind by remove_data
+				std::vector<uint32_t> freeVertices;
+				std::vector<uint32_t> freeTriangles;
 			protected:
 				/**
 				 * \brief Set the super triangle that encompasses a rectangle
@@ -155,6 +327,39 @@ namespace realtimeplot {
 				 * This method is normally only used internally
 				 */
 				void setSuperTriangle( float min_x, float max_x, float min_y, float max_y ); 	
+
+				/**
+				 * \brief Split the edge opposite to corner c at the new vertex
+				 *
+				 * Both triangles sharing the edge are split into two, so that no 
+				 * triangle with zero area is created. Returns index of the new vertex
+				 */
+				uint32_t splitEdge( const Vertex &vertex, uint32_t c );
+
+				//! Store a vertex, reusing a free index if possible
+				uint32_t newVertex( const Vertex &vertex );
+
+				//! Index of an unused triangle, added at the end if none is free
+				uint32_t newTriangle();
+
+				//! Number of grid cells in each dimension used to find a start triangle
+				static const size_t noSeedCells = 16;
+
+				//! Grid cell of a vertex (clamped to the grid)
+				size_t seedCell( const Vertex &vertex ) const;
+
+				//! Triangle recently created in each grid cell (noCorner if none)
+				std::vector<uint32_t> seeds;
+				float seed_min_x, seed_min_y, seed_width_x, seed_width_y;
+				uint32_t lastTriangle;
+
+				//! Make a and b each others opposite (either can be noCorner)
+				void setOpposites( uint32_t a, uint32_t b ) {
+					if (a != noCorner)
+						opposites[a] = b;
+					if (b != noCorner)
+						opposites[b] = a;
+				}
 		};
 	};
 };
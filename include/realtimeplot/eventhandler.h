@@ -25,6 +25,9 @@
 #define CAIRO_PLOT_EVENTHANDLER_H
 
 #include <list>
+#include <deque>
+#include <vector>
+#include <atomic>
 
 #include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
@@ -56,6 +59,14 @@ namespace realtimeplot {
             Event() {}
             virtual void execute(
 								boost::shared_ptr<BackendPlot> &bPl ) const {}
+
+            /**
+             * \brief Does this event only draw data?
+             *
+             * Such events can be left out when an adaptive plot thins out
+             * the events it keeps for redrawing.
+             */
+            virtual bool droppable() const { return false; }
     };
 
 
@@ -65,15 +76,20 @@ namespace realtimeplot {
 		In theory the event class should almost never slow down the main program, but
 		currently if the queueu gets to big (>1000) add_event will block, so that 
 		backendplot has time to clear some events.
+
+		When pooled, no thread is started. Instead the handler is handed to the
+		WorkerPool whenever it has events, which processes them in order. An idle
+		pooled handler uses no thread at all.
 		*/
     class EventHandler : public boost::enable_shared_from_this<EventHandler> {
         public:
+					//! Null if pooled
 					boost::shared_ptr<boost::thread> pEventProcessingThrd;
 
 					cppa::actor_ptr ev_actor;
 
           //Constructor
-					EventHandler();
+					EventHandler( bool pooled = false );
 					~EventHandler();
 
 					//Add an event to the event queue
@@ -81,6 +97,15 @@ namespace realtimeplot {
 							bool high_priority=false );
 					int get_queue_size();
 
+					/**
+					 * \brief Block till all events are processed and the plot is freed
+					 *
+					 * I.e. till a FinalEvent has been processed and the window is closed
+					 */
+					void join();
+					//! Let the events be processed without waiting for it
+					void detach();
+
 					// ! Are/Should we be processing events
 					bool processing_events;
 					bool window_closed;
@@ -88,12 +113,84 @@ namespace realtimeplot {
 					friend class TestBackendWithCairo;
 					friend class ::TestAdaptive;
 					friend class ::TestPlot;
+					friend class WorkerPool;
 				protected:
 					boost::shared_ptr<BackendPlot> pBPlot;
 					ThreadSplitQueue<boost::shared_ptr<Event> > event_queue;
 
+					bool pooled;
+					//! Handler is queued on or being run by the WorkerPool
+					std::atomic<bool> scheduled;
+					//! Done processing, pBPlot has been freed
+					bool finished;
+					boost::mutex finished_mutex;
+					boost::condition_variable finished_cond;
+
 					virtual void process_events();
 
+					/**
+					 * \brief Handle one event
+					 *
+					 * Shared by the event processing thread and the WorkerPool
+					 */
+					virtual void process_event( boost::shared_ptr<Event> pEvent );
+
+					//! Process a number of queued events, called by the WorkerPool
+					void process_batch();
+
+					//! Hand the handler to the WorkerPool, unless it already is
+					void schedule();
+
+					//! Let go of the plot and wake up join
+					void finish();
+		};
+
+		/**
+		 * \brief Fixed number of threads that process the events of pooled handlers
+		 *
+		 * Each worker has its own deque of handlers with pending events. Workers
+		 * take handlers from the front of their own deque and steal from the back
+		 * of the others when theirs is empty. A handler runs on only one worker at 
+		 * a time, so its events are still processed in order. Busy handlers are 
+		 * put back after a batch of events, so one busy plot can not starve the
+		 * others.
+		 */
+		class WorkerPool {
+			public:
+				static WorkerPool* Instance();
+
+				//! Queue a handler that has events to process
+				void schedule( boost::shared_ptr<EventHandler> pHandler );
+
+				size_t no_threads;
+				//! Number of events processed before a handler is put back
+				size_t batch_size;
+
+			protected:
+				WorkerPool();
+
+				struct Worker {
+					boost::mutex mutex;
+					std::deque<boost::shared_ptr<EventHandler> > handlers;
+				};
+				std::vector<boost::shared_ptr<Worker> > workers;
+				//! Worker that handlers scheduled from other threads go to next
+				std::atomic<size_t> next_worker;
+
+				boost::mutex idle_mutex;
+				boost::condition_variable handler_added;
+				//! Number of handlers waiting in the deques
+				size_t no_scheduled;
+
+				boost::thread_group threads;
+
+				void work( size_t id );
+				//! Take a handler from our own deque, or steal one
+				boost::shared_ptr<EventHandler> take( size_t id );
+
+			private:
+				static WorkerPool* pInstance;
+				static boost::mutex i_mutex;
 		};
 }
 #endif
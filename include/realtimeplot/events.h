@@ -56,6 +56,8 @@ namespace realtimeplot {
             MultipleEvents( std::vector<boost::shared_ptr<Event> > events );
             virtual void execute( 
 								boost::shared_ptr<BackendPlot> &pBPlot ) const;
+            //! Droppable as a whole if it draws any data (e.g. set color + point)
+            virtual bool droppable() const;
          private:
             std::vector<boost::shared_ptr<Event> > events;
     };
@@ -115,6 +117,7 @@ namespace realtimeplot {
         public:
             PointEvent( float x, float y );
             virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const;
+            virtual bool droppable() const { return true; }
         private:
             float x_crd, y_crd;
     };
@@ -143,6 +146,17 @@ namespace realtimeplot {
 				}
 		};
 
+		/**
+		 * \brief Start or stop recording the shown frames to numbered png files
+		 */
+		class RecordEvent : public Event {
+			public:
+				RecordEvent() {};
+				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const {
+					pBPlot->record( !pBPlot->recording );
+				}
+		};
+
 		class MoveEvent : public Event {
 			public:
 				MoveEvent( int direction_x, int direction_y ) :
@@ -204,12 +218,32 @@ namespace realtimeplot {
             RectangleEvent( float min_x, float min_y, float width_x, float width_y,
 								bool fill, Color color );
             virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const;
+            virtual bool droppable() const { return true; }
         private:
 						float min_x, min_y, width_x, width_y;
 						bool fill;
 						Color color;
     };
 
+		/**
+		 \brief Event that draws a grid of counts in one go
+
+		 Counts are stored as [x*no_y+y] and drawn as grey shades, going from 
+		 white (0) to black (max_count).
+		 */
+    class GridEvent : public Event {
+        public:
+            GridEvent( float min_x, float min_y, float width_x, float width_y,
+								size_t no_x, size_t no_y, const std::vector<size_t> &counts, 
+								size_t max_count );
+            virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const;
+        private:
+						float min_x, min_y, width_x, width_y;
+						size_t no_x, no_y;
+						std::vector<size_t> counts;
+						size_t max_count;
+    };
+
  		/**
 		 \brief Event that adds a point to an existing line
 
@@ -221,6 +255,7 @@ namespace realtimeplot {
         public:
             LineAddEvent( float x, float y, int id, Color color );
             virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const;
+            virtual bool droppable() const { return true; }
         private:
             float x_crd, y_crd;
             int id;
@@ -255,10 +290,11 @@ namespace realtimeplot {
       */
     class SaveEvent : public Event {
         public:
-            SaveEvent( std::string filename );
+            SaveEvent( std::string filename, SaveCallback callback = SaveCallback() );
             virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const;
         private:
             std::string filename;
+            SaveCallback callback;
     };
 
 		/**
@@ -272,6 +308,20 @@ namespace realtimeplot {
 						}
     };
 
+		/**
+		 \brief Event to show part of the last shown frame again (e.g. after an expose)
+		 */
+    class DisplayRegionEvent : public Event {
+        public:
+            DisplayRegionEvent( int x, int y, int width, int height ) 
+							: x( x ), y( y ), width( width ), height( height ) {};
+            virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot )  const{
+							pBPlot->display_region( x, y, width, height );
+						}
+        private:
+            int x, y, width, height;
+    };
+
 		/**
 		 \brief Event to clear the current plot
 		 */
@@ -334,15 +384,32 @@ namespace realtimeplot {
 
 		class HistDataEvent : public Event {
 			public:
-				HistDataEvent( double new_data )
-					: new_data( new_data )
+				HistDataEvent( double new_data, size_t series = 0 )
+					: new_data( new_data ), series( series )
 			{}
 				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot )  const{
 					boost::static_pointer_cast<BackendHistogram, 
-						BackendPlot>(pBPlot)->add_data( new_data );
+						BackendPlot>(pBPlot)->add_data( new_data, series );
 				}
 			private:
 				double new_data;
+				size_t series;
+		};
+
+		/**
+		 * \brief Stack or overlay the series in a histogram
+		 */
+		class HistStackEvent : public Event {
+			public:
+				HistStackEvent( bool stacked ) 
+				: stacked( stacked ) 
+				{};
+				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot )  const{
+					boost::static_pointer_cast<BackendHistogram, 
+						BackendPlot>(pBPlot)->stacked = stacked;
+				}
+			private:
+				bool stacked;
 		};
 
 		class HistOptimizeEvent : public Event {
@@ -358,6 +425,35 @@ namespace realtimeplot {
 				double proportion;
 		};
 
+		/**
+		 * \brief Only show recent data in the histogram
+		 *
+		 * If decaying is false this starts a sliding window of length samples
+		 * (or seconds) made up of no_steps slices, otherwise weights halve every
+		 * length samples (or seconds), decaying in no_steps steps.
+		 */
+		class HistWindowEvent : public Event {
+			public:
+				HistWindowEvent( bool decaying, double length, size_t no_steps,
+						bool in_seconds ) 
+				: decaying( decaying ), length( length ), no_steps( no_steps ),
+				in_seconds( in_seconds )
+				{};
+				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot )  const{
+					boost::shared_ptr<BackendHistogram> pHist =
+						boost::static_pointer_cast<BackendHistogram, BackendPlot>(pBPlot);
+					if (decaying)
+						pHist->decaying_window( length, no_steps, in_seconds );
+					else
+						pHist->sliding_window( length, no_steps, in_seconds );
+				}
+			private:
+				bool decaying;
+				double length;
+				size_t no_steps;
+				bool in_seconds;
+		};
+
 		class HistPlotEvent : public Event {
 			public:
 				HistPlotEvent() {};
@@ -472,6 +568,53 @@ namespace realtimeplot {
 				bool show;
 		};
 
+		/**
+		 * \brief Add a batch of points to a HeightMap
+		 */
+		class HMDataSetEvent : public Event {
+			public:
+				HMDataSetEvent( const std::vector<float> &xs, const std::vector<float> &ys,
+						const std::vector<float> &zs, bool show );
+				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const;
+			private:
+				std::vector<float> xs, ys, zs;
+				bool show;
+		};
+
+		/**
+		 * \brief Only keep the most recent points of a HeightMap
+		 */
+		class HMWindowEvent : public Event {
+			public:
+				HMWindowEvent( size_t max_points, double max_age ) 
+				: max_points( max_points ), max_age( max_age )
+				{};
+				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot )  const{
+					boost::static_pointer_cast<BackendHeightMap, BackendPlot>( 
+							pBPlot )->sliding_window( max_points, max_age );
+				}
+			private:
+				size_t max_points;
+				double max_age;
+		};
+
+		/**
+		 * \brief Draw contour lines on a HeightMap
+		 */
+		class HMContoursEvent : public Event {
+			public:
+				HMContoursEvent( const std::vector<float> &levels, Color color ) 
+				: levels( levels ), color( color )
+				{};
+				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot )  const{
+					boost::static_pointer_cast<BackendHeightMap, BackendPlot>( 
+							pBPlot )->contours( levels, color );
+				}
+			private:
+				std::vector<float> levels;
+				Color color;
+		};
+
 		/**
 		 * \brief Causes HeightMap to calculate it's optimal coloring scheme
 		 */
@@ -482,6 +625,62 @@ namespace realtimeplot {
 				boost::static_pointer_cast<BackendHeightMap, BackendPlot>( pBPlot )->calculate_height_scaling();
 				}
 		};
+
+		/*
+		 * GridHeightMap
+		 */
+		class OpenGridHeightMapEvent : public Event {
+			public:
+				OpenGridHeightMapEvent( PlotConfig plot_conf, 
+						boost::shared_ptr<EventHandler> pEventHandler,
+						size_t no_x, size_t no_y );
+				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const;
+			private:
+				PlotConfig plot_conf;
+				boost::shared_ptr<EventHandler> pEventHandler;
+				size_t no_x, no_y;
+		};
+
+		/**
+		 * \brief Set the height of one lattice node of a GridHeightMap
+		 */
+		class GridHMDataEvent : public Event {
+			public:
+				GridHMDataEvent( float x, float y, float z, bool show ) 
+					: x(x), y(y), z(z), show( show ) {}
+				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const {
+					boost::static_pointer_cast<BackendGridHeightMap, BackendPlot>( 
+							pBPlot )->add_data( x, y, z, show );
+				}
+			private:
+				float x, y, z;
+				bool show;
+		};
+
+		/**
+		 * \brief Replace all heights of a GridHeightMap
+		 */
+		class GridHMSetDataEvent : public Event {
+			public:
+				GridHMSetDataEvent( const std::vector<float> &zs, bool show ) 
+					: zs( zs ), show( show ) {}
+				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const {
+					boost::static_pointer_cast<BackendGridHeightMap, BackendPlot>( 
+							pBPlot )->set_data( zs, show );
+				}
+			private:
+				std::vector<float> zs;
+				bool show;
+		};
+
+		class GridHMHeightScalingEvent : public Event {
+			public:
+				GridHMHeightScalingEvent() {};
+				virtual void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const {
+					boost::static_pointer_cast<BackendGridHeightMap, BackendPlot>( 
+							pBPlot )->calculate_height_scaling();
+				}
+		};
  }
 #endif
 
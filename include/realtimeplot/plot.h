@@ -31,11 +31,14 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <stdint.h>
 
 
 #include <boost/shared_ptr.hpp>
 #include <boost/math/special_functions/beta.hpp>
 
+#include "realtimeplot/pngwriter.h"
+
 //#include "realtimeplot/eventhandler.h"
 
 namespace realtimeplot {
@@ -62,6 +65,11 @@ namespace realtimeplot {
 
 			bool operator==(const Color &color) const;
 
+			/**
+			 * \brief Color as a (cairo) premultiplied ARGB32 pixel value
+			 */
+			uint32_t argb32() const;
+
 			static Color black();
 			static Color white();
 			static Color red();
@@ -99,20 +107,56 @@ namespace realtimeplot {
 	 * Values need to be between 0 and 1. ColorMap can also calculate an optimal scaling
 	 * for your values, to ensure that most color differences are largest in the value
 	 * range where most values are located
+	 *
+	 * The colors are interpolated linearly between the colors of a palette, by default
+	 * yellow, red and black. For fast drawing the (scaled) colors are also stored in a 
+	 * lookup table, which is updated whenever the palette or scaling changes. If you
+	 * change alpha, beta or scaling directly you need to call update_lut yourself.
 	 */
 	class ColorMap {
 		public:
 			double alpha, beta;
 			bool scaling;
+
+			//! Number of entries in the lookup table
+			static const size_t lut_size = 4096;
+
 			ColorMap();
 			
 			/**
 			 * \brief Return color corresponding to proportion
 			 *
-			 * With proportion between 0 and 1
+			 * With proportion between 0 and 1. Calculates the exact color, use lookup
+			 * or argb32 when speed matters.
 			 */
 			Color operator()( double proportion );
 
+			/**
+			 * \brief Color of the nearest entry in the lookup table
+			 */
+			Color lookup( double proportion ) const;
+
+			/**
+			 * \brief Premultiplied ARGB32 value of the nearest entry in the lookup table
+			 *
+			 * Values outside [0,1] are clamped.
+			 */
+			uint32_t argb32( double proportion ) const;
+
+			/**
+			 * \brief Look up a whole batch of proportions at once
+			 */
+			void argb32( const std::vector<double> &proportions, 
+					std::vector<uint32_t> &colors ) const;
+
+			/**
+			 * \brief Use your own palette
+			 *
+			 * The colors are spread evenly over [0,1], with palette.front() used for 0
+			 * and palette.back() for 1.
+			 */
+			void set_palette( const std::vector<Color> &palette );
+
 			/**
 			 * \brief Height scaling for data with mean and variance
 			 *
@@ -122,6 +166,20 @@ namespace realtimeplot {
 			void calculate_height_scaling( double mean, double var );
 
 			double scale( double proportion );
+
+			//! Recalculate the lookup table
+			void update_lut();
+
+			//! Premultiplied ARGB32 colors of the lookup table (from 0 to 1)
+			const std::vector<uint32_t> &lookup_table() const {
+				return lut;
+			}
+
+		private:
+			std::vector<Color> palette;
+			std::vector<uint32_t> lut;
+
+			size_t lut_index( double proportion ) const;
 	};
 
 
@@ -164,12 +222,59 @@ namespace realtimeplot {
 			 */
 			size_t no_adaptive_events;
 
+			/**
+			 * \brief Keep adapting the plotting range for the whole session
+			 *
+			 * Instead of stopping after no_adaptive_events, the adaptive plot then
+			 * thins out the data events it keeps (points, lines and rectangles) 
+			 * whenever no_adaptive_events is reached. Every other one is dropped and 
+			 * from then on only every second new one is kept, so memory stays 
+			 * bounded by no_adaptive_events while the kept events still cover the 
+			 * whole session. Data that was left out disappears when the plot is 
+			 * rescaled.
+			 */
+			bool keep_adapting;
+
 			/**
 			 * \brief Display the plot or not
 			 *
 			 * You'll need to save the plot explicitly if you set this to false
 			 */
 			bool display;
+
+			/**
+			 * \brief Stream the shown frames to this file or FIFO instead of a window
+			 *
+			 * Frames are written frame_rate times per second, as YUV4MPEG2 video if
+			 * the path ends in .y4m and as raw RGBA otherwise. Works without X, e.g.
+			 * ffmpeg -i plot.y4m plot.mp4. Empty (default) opens a window.
+			 */
+			std::string frame_sink;
+			double frame_rate;
+
+			/**
+			 * \brief Process the events on the shared WorkerPool
+			 *
+			 * By default every plot has its own thread. With many plots open it is
+			 * cheaper to let a fixed number of worker threads (one per core) share
+			 * them. Events of one plot are still processed in order.
+			 */
+			bool worker_pool;
+
+			/**
+			 * \brief zlib compression level (0-9) of saved png files
+			 *
+			 * Lower levels write faster but give bigger files.
+			 */
+			int png_compression_level;
+			/**
+			 * \brief Row filters tried for saved png files
+			 *
+			 * Combination of libpng's PNG_FILTER_* flags, e.g. PNG_FILTER_NONE for 
+			 * the fastest encoding. 0 (default) lets libpng choose.
+			 */
+			int png_filters;
+
 			int label_font_size, numerical_labels_font_size;
 
 			/***
@@ -223,7 +328,13 @@ namespace realtimeplot {
 			 * Text will be left justified
 			 */
 			void text( float x, float y, std::string text );
-			void save( std::string filename );
+			/**
+			 * \brief Save the plot as png
+			 *
+			 * The file is written in the background, the optional callback is 
+			 * called (from a writer thread) once it has been written.
+			 */
+			void save( std::string filename, SaveCallback callback = SaveCallback() );
 			/**
 			 * \brief Clear the plot, i.e. fill it with its background color
 			 */
@@ -262,7 +373,7 @@ namespace realtimeplot {
 			boost::shared_ptr<EventHandler> pEventHandler;
 		protected:
 			//! Constructor which doesn't immediately open a plot (only used by children at the moment)
-			Plot( bool open );
+			Plot( bool open, bool pooled = false );
 	};
 
 	/**
@@ -280,6 +391,13 @@ namespace realtimeplot {
 		*/
 	class Histogram : public Plot {
 		public:
+			/**
+			 * \brief Creates a histogram with the given config
+			 *
+			 * The only constructor that can process its events on the WorkerPool 
+			 * (PlotConfig::worker_pool). Set fixed_plot_area, min_x and max_x for 
+			 * a set range.
+			 */
 			Histogram( PlotConfig config, size_t no_bins = 4, bool frequency = true );
 
 			Histogram( size_t no_bins = 4, bool frequency = true );
@@ -303,6 +421,31 @@ namespace realtimeplot {
 			 * replot every time.
 			 */
 			void add_data( double data, bool show = true );
+
+			/**
+			 * \brief Set data of one series
+			 *
+			 * Multiple series share the same bins and are plotted in one histogram,
+			 * each in the color Color::by_id(series). Data added without a series
+			 * belongs to series 0.
+			 */
+			void set_data( size_t series, std::vector<double> data, 
+					bool show = true );
+
+			/**
+			 * \brief Add a new measurement/data to a series
+			 */
+			void add_series_data( size_t series, double data, bool show = true );
+
+			/**
+			 * \brief Stack the series on top of each other
+			 *
+			 * By default series are overlaid. When overlaid and plotting
+			 * frequencies, each series is normalised separately. When stacked
+			 * the total of all series is used.
+			 */
+			void stack_series( bool stack = true );
+
 			/**
 			 * \brief (Re) Plot the data
 			 */
@@ -316,6 +459,32 @@ namespace realtimeplot {
 			 * Should probably only be called after most/all data is added.
 			 */
 			void optimize_bounds( double proportion = 0.9 );
+
+			/**
+			 * \brief Only show the last no_samples measurements
+			 *
+			 * Older data is forgotten in steps of no_samples/no_slices. The bin 
+			 * edges are frozen when the window starts (at the fixed plot area or 
+			 * the range of the data added so far), so for a live monitor either
+			 * use a fixed min_x/max_x or add some representative data first.
+			 * Memory use and cost per measurement are constant from then on.
+			 */
+			void sliding_window( size_t no_samples, size_t no_slices = 10 );
+
+			//! Only show the measurements of the last seconds
+			void sliding_window_seconds( double seconds, size_t no_slices = 10 );
+
+			/**
+			 * \brief Exponentially forget old measurements
+			 *
+			 * The weight of a measurement halves every half_life measurements. 
+			 * Decay is applied in no_steps steps per half life. Bin edges are 
+			 * frozen as for sliding_window.
+			 */
+			void decaying_window( double half_life, size_t no_steps = 10 );
+
+			//! Weight of measurements halves every half_life seconds
+			void decaying_window_seconds( double half_life, size_t no_steps = 10 );
 	};
 
 	/**
@@ -327,6 +496,13 @@ namespace realtimeplot {
 	 */
 	class Histogram3D : public Plot {
 		public:
+			/**
+			 * \brief Creates a histogram with the given config
+			 *
+			 * The only constructor that can process its events on the WorkerPool 
+			 * (PlotConfig::worker_pool). Set fixed_plot_area and the bounds for 
+			 * a set range.
+			 */
 			Histogram3D( PlotConfig config, size_t no_bins_x = 4, 
 					size_t no_bins_y = 4 );
 
@@ -380,15 +556,17 @@ namespace realtimeplot {
 
 			SurfacePlot( float min_x, float max_x, float min_y, float max_y, 
 					size_t resolution = 20 );
+			//! Uses the bounds and worker_pool of config
+			SurfacePlot( PlotConfig config, size_t resolution = 20 );
 			void add_data( float x, float y, bool show=true );
 
+			//! Sends the whole grid as one GridEvent
 			void plot();
 
 		private:
 			float width_x, width_y;
-			//! Actually store lower bounds of the bins.
-			std::vector<float> bins_x;
-			std::vector<float> bins_y;
+			//! Lower bounds of the first bin
+			float min_x, min_y;
 	};
 
 	/**
@@ -401,10 +579,42 @@ namespace realtimeplot {
 		public:
 			HeightMap(); //float min_x, float max_x, float min_y, float max_y );
 			HeightMap( float min_x, float max_x, float min_y, float max_y );
+			//! Uses the bounds and worker_pool of config
+			HeightMap( PlotConfig config );
 
 			//! Sends an HeightMapData event to eventhandler
 			void add_data( float x, float y, float z, bool show=true );
 
+			/**
+			 * \brief Add many points at once
+			 *
+			 * Much faster than adding them one by one: the points are sorted 
+			 * spatially before they are triangulated and the map is only drawn once,
+			 * after the whole batch has been added. If the map is still empty the 
+			 * triangulation is build with a parallel divide and conquer algorithm.
+			 */
+			void set_data( const std::vector<float> &xs, const std::vector<float> &ys,
+					const std::vector<float> &zs, bool show=true );
+
+			/**
+			 * \brief Only show the most recent points
+			 *
+			 * The oldest points are removed once there are more than max_points 
+			 * points or when they are older than max_age seconds. A limit of 0 
+			 * disables it. The triangulation is repaired locally, so only the part
+			 * of the map around a removed point is redrawn.
+			 */
+			void sliding_window( size_t max_points, double max_age = 0 );
+
+			/**
+			 * \brief Draw contour lines at the given heights on top of the map
+			 *
+			 * The lines follow the triangulation and are kept up to date as data is 
+			 * added. Call with an empty list to remove them.
+			 */
+			void contours( const std::vector<float> &levels, 
+					Color color = Color::black() );
+
 			/**
 			 * \brief Calculates parameters that should lead to "optimal" colouring
 			 *
@@ -420,6 +630,34 @@ namespace realtimeplot {
 			void calculate_height_scaling();
 	};
 
+	/**
+	 * \brief Plot a height map of data on a regular lattice
+	 *
+	 * The lattice has no_x by no_y nodes, with the corner nodes at the corners
+	 * of the plot area. Heights are drawn with bilinear interpolation between the 
+	 * nodes, which is much cheaper than HeightMap for gridded data.
+	 */
+	class GridHeightMap : public Plot {
+		public:
+			GridHeightMap( float min_x, float max_x, float min_y, float max_y,
+					size_t no_x, size_t no_y );
+			//! Uses the bounds and worker_pool of config
+			GridHeightMap( PlotConfig config, size_t no_x, size_t no_y );
+
+			/**
+			 * \brief Set the height of the lattice node closest to (x, y)
+			 *
+			 * Only redraws the neighbourhood of that node
+			 */
+			void add_data( float x, float y, float z, bool show=true );
+
+			//! Set all heights, indexed by [x*no_y+y]
+			void set_data( const std::vector<float> &zs, bool show=true );
+
+			//! See HeightMap::calculate_height_scaling
+			void calculate_height_scaling();
+	};
+
 
 }
 #endif
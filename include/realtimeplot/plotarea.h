@@ -26,6 +26,7 @@
 
 #include <cairomm/context.h>
 #include "realtimeplot/plot.h"
+#include "realtimeplot/delaunay.h"
 
 namespace realtimeplot {
 	/**
@@ -82,6 +83,49 @@ namespace realtimeplot {
 
 			void point( float x, float y );
 
+			/**
+			 * \brief Paint an image scaled to the given rectangle
+			 *
+			 * Uses nearest neighbour filtering, so each image pixel becomes a sharp cell
+			 */
+			void image( const Cairo::RefPtr<Cairo::ImageSurface> &image, 
+					float min_x, float min_y, float width_x, float width_y );
+
+			/**
+			 * \brief Rasterise Gouraud shaded triangles straight into the surface
+			 *
+			 * Triangle i has the vertices indices[3*i], indices[3*i+1] and 
+			 * indices[3*i+2]. Values of the vertices are mapped linearly from 
+			 * [min_value, max_value] onto the lookup table and interpolated per pixel.
+			 * Bypasses the cairo context, so no antialiasing is done.
+			 *
+			 * The surface is split in bands of rows, each drawn by its own thread
+			 * (no_threads == 0 uses all available cores).
+			 */
+			void triangles( const std::vector<delaunay::Vertex> &vertices,
+					const std::vector<float> &values, float min_value, float max_value,
+					const std::vector<uint32_t> &indices, const std::vector<uint32_t> &lut,
+					size_t no_threads = 0 );
+
+			/**
+			 * \brief Draw a lattice of values with bilinear interpolation
+			 *
+			 * Node (i, j) lies at (min_x+i*width_x, min_y+j*width_y) and has value
+			 * values[i*no_y+j], mapped linearly from [min_value, max_value] onto the 
+			 * lookup table. Only the pixels of the cells between nodes first_x..last_x
+			 * and first_y..last_y are drawn.
+			 */
+			void bilinear( const std::vector<float> &values, size_t no_x, size_t no_y,
+					float min_x, float min_y, float width_x, float width_y,
+					float min_value, float max_value, const std::vector<uint32_t> &lut,
+					size_t first_x, size_t last_x, size_t first_y, size_t last_y );
+
+			/**
+			 * \brief Stroke line segments, given as pairs of end points, as one path
+			 */
+			void segments( const std::vector<delaunay::Vertex> &ends, 
+					const Color &color );
+
 			void line_add( float x, float y, int id );
 			
 			/**
@@ -92,6 +136,14 @@ namespace realtimeplot {
 			void reposition( float center_x, float center_y);
 
 			void clear();
+
+			/**
+			 * \brief Fill a rectangle with the background color
+			 *
+			 * Not antialiased, so exactly the pixels with their center inside the
+			 * rectangle are cleared.
+			 */
+			void clear( float min_x, float min_y, float width_x, float width_y );
 		//private:
 			//Keep track to lines
 			std::map<int, boost::shared_ptr<LineAttributes> > lines;
@@ -0,0 +1,146 @@
+/*
+	 -------------------------------------------------------------------
+
+	 Copyright (C) 2010, Edwin van Leeuwen
+
+	 This file is part of RealTimePlot.
+
+	 RealTimePlot is free software; you can redistribute it and/or modify
+	 it under the terms of the GNU General Public License as published by
+	 the Free Software Foundation; either version 3 of the License, or
+	 (at your option) any later version.
+
+	 RealTimePlot is distributed in the hope that it will be useful,
+	 but WITHOUT ANY WARRANTY; without even the implied warranty of
+	 MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	 GNU General Public License for more details.
+
+	 You should have received a copy of the GNU General Public License
+	 along with RealTimePlot. If not, see <http://www.gnu.org/licenses/>.
+
+	 -------------------------------------------------------------------
+	 */
+#ifndef REALTIMEPLOT_PNGWRITER_H
+#define REALTIMEPLOT_PNGWRITER_H
+
+/** \file pngwriter.h
+	\brief Writes png files on background threads
+	*/
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace realtimeplot {
+	/**
+	 * \brief Called when a png file is written (or failed to be written)
+	 *
+	 * Runs on one of the writer threads, so should not take long and should not
+	 * add events to the plot that saved the file.
+	 */
+	typedef boost::function<void (const std::string &filename, bool success)>
+		SaveCallback;
+
+	/**
+	 * \brief Image kept in memory until it is written
+	 *
+	 * Pixels are stored as premultiplied native endian ARGB32, the layout cairo
+	 * uses, so an ImageSurface can be created on top of data to draw into it.
+	 */
+	struct PngImage {
+		PngImage( int width, int height );
+		int width, height, stride;
+		std::vector<unsigned char> data;
+	};
+
+	/**
+	 * \brief Number of queued images of one owner (e.g. a plot)
+	 *
+	 * Lets the owner wait for its own images only, instead of for everything 
+	 * queued by all plots.
+	 */
+	class PngJobCounter {
+		public:
+			PngJobCounter() : no_pending( 0 ) {}
+
+			//! Block until all images queued with this counter have been written
+			void wait();
+
+			friend class PngWriter;
+		protected:
+			boost::mutex mutex;
+			boost::condition_variable all_done;
+			size_t no_pending;
+
+			void add();
+			void done();
+	};
+
+	/**
+	 * \brief Pool of threads that encode and write png files
+	 *
+	 * Encoding a png takes much longer than drawing a frame, so the event thread
+	 * only takes a snapshot of the plot and queues it here. Shared by all plots.
+	 */
+	class PngWriter {
+		public:
+			static PngWriter* Instance();
+
+			/**
+			 * \brief Queue an image to be written to filename
+			 *
+			 * compression_level is the zlib level (0-9) and filters a combination of
+			 * PNG_FILTER_* flags (0 lets libpng choose). When droppable is set and
+			 * the writers are falling behind the image is dropped instead, which
+			 * is reported by returning false (callback is not called). A given 
+			 * counter counts the image until it is written.
+			 */
+			bool add( boost::shared_ptr<PngImage> pImage, std::string filename,
+					int compression_level, int filters,
+					SaveCallback callback = SaveCallback(), bool droppable = false,
+					boost::shared_ptr<PngJobCounter> pCounter = 
+					boost::shared_ptr<PngJobCounter>() );
+
+			//! Block until all queued images have been written
+			void wait();
+
+			//! Write an image straight away, returns false on failure
+			static bool write( const PngImage &image, const std::string &filename,
+					int compression_level, int filters );
+
+			size_t no_threads;
+			//! Maximum number of queued droppable images
+			size_t max_queued;
+
+		protected:
+			PngWriter();
+
+			struct Job {
+				boost::shared_ptr<PngImage> pImage;
+				std::string filename;
+				int compression_level, filters;
+				SaveCallback callback;
+				boost::shared_ptr<PngJobCounter> pCounter;
+			};
+
+			boost::mutex mutex;
+			boost::condition_variable job_added, job_done;
+			std::deque<Job> jobs;
+			//! Number of jobs currently being written
+			size_t no_active;
+			boost::thread_group workers;
+
+			void work();
+
+		private:
+			static PngWriter* pInstance;
+			static boost::mutex i_mutex;
+	};
+}
+#endif
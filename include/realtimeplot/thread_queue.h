@@ -260,6 +260,21 @@ namespace realtimeplot {
 				return el;
 			}
 
+			/**
+			 * \brief Like pop, but returns false instead of blocking when the queue is empty
+			 */
+			bool try_pop( T &el ) {
+				boost::mutex::scoped_lock lock( m_mutex );
+				if (priority_size() > 0)
+					el = priority_queue_pop();
+				else if (normal_size() > 0)
+					el = queue_pop();
+				else
+					return false;
+				cond.notify_one();
+				return true;
+			}
+
 		protected:
 			std::queue<T> queue;
 			std::queue<T> priority_queue;
@@ -25,6 +25,7 @@
 
 #include<iostream>
 #include<vector>
+#include<stdint.h>
 
 namespace realtimeplot {
 	/**
@@ -79,6 +80,86 @@ namespace realtimeplot {
 		std::vector<size_t> range_of_bins_covering( double percentage,
 				std::vector<double> bins );
 
+		/**
+		 * \brief Bin counts that only remember recent data
+		 *
+		 * Time is measured by a clock supplied by the caller (number of samples seen,
+		 * seconds since start, ...). Every period clock units the window rotates.
+		 *
+		 * In sliding mode the counts are kept in a ring of no_slices sub histograms,
+		 * rotating drops the oldest one. The window thus covers between
+		 * (no_slices-1)*period and no_slices*period clock units.
+		 *
+		 * In decaying mode all counts are multiplied by factor on every rotation.
+		 *
+		 * Both modes cost O(no_bins) per rotation and O(1) per added sample, and use
+		 * constant memory.
+		 */
+		class WindowedBins {
+			public:
+				WindowedBins();
+
+				/**
+				 * \brief Keep a ring of no_slices sub histograms of period clock units each
+				 */
+				void set_sliding( size_t no_bins, size_t no_slices, double period );
+
+				/**
+				 * \brief Multiply all counts by factor every period clock units
+				 */
+				void set_decaying( size_t no_bins, double factor, double period );
+
+				/**
+				 * \brief Add weight to the given bin at time clock
+				 */
+				void add( size_t bin, double clock, double weight = 1 );
+
+				/**
+				 * \brief Rotate the window up to time clock
+				 *
+				 * Clock should not decrease between calls.
+				 */
+				void advance( double clock );
+
+				/**
+				 * \brief Change the number of bins, keeping the counts of existing bins
+				 */
+				void resize( size_t no_bins );
+
+				//! Forget all data and restart the clock at 0
+				void clear();
+
+				//! Current (windowed) counts per bin
+				const std::vector<double> &bins() const;
+
+				//! Sum of the counts in the window
+				double total() const;
+
+				bool decaying;
+				size_t no_slices;
+				double period;
+				double factor;
+
+			private:
+				void rotate( size_t no_rotations );
+
+				std::vector<double> totals;
+				//! Sub histograms, slice i is stored at [i*no_bins, (i+1)*no_bins)
+				std::vector<double> slices;
+				size_t current_slice;
+				double next_rotation;
+				double sum;
+		};
+
+		/**
+		 * \brief Convert a row of cairo ARGB32 pixels to straight RGBA bytes
+		 *
+		 * Cairo pixels are native endian premultiplied 0xaarrggbb, png files and 
+		 * raw frames want straight alpha. rgba needs room for 4*width bytes.
+		 */
+		void argb_to_rgba( const uint32_t *pixels, size_t width, 
+				unsigned char *rgba );
+
 		/**
 			\brief Util function to turn doubles into strings
 			*/
@@ -23,19 +23,27 @@
 
 #ifndef REALTIMEPLOT_XCBHANDLER_H
 #define REALTIMEPLOT_XCBHANDLER_H
+#include <atomic>
 #include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #ifndef NO_X
 #include <xcb/xcb.h>
+#ifndef NO_SHM
+#include <xcb/shm.h>
+#endif
 #endif
 
 #include <cairomm/surface.h>
 
 #include "realtimeplot/eventhandler.h"
 
+class TestXcbHandler;
 
 namespace realtimeplot {
 	/**
@@ -58,11 +66,40 @@ namespace realtimeplot {
 			/**
 			 * \brief Return a cairo surface that draws onto a window
 			 *
-			 * Used by BackendPlot to get a surface to draw to.
+			 * Used by BackendPlot to get a surface to draw to. What is drawn might 
+			 * only show up after a call to present.
 			 */
 			virtual Cairo::RefPtr<Cairo::Surface> get_cairo_surface( 
 					size_t window_id, size_t width, size_t height ) = 0;
 
+			/**
+			 * \brief Return an image to compose the next frame of a window into
+			 *
+			 * The frame is then shown with present. Returns an empty pointer if the
+			 * handler has no such image, in which case frames should be painted 
+			 * onto the surface from get_cairo_surface.
+			 */
+			virtual Cairo::RefPtr<Cairo::ImageSurface> get_present_surface( 
+					size_t window_id, size_t width, size_t height ) {
+				return Cairo::RefPtr<Cairo::ImageSurface>();
+			}
+
+			/**
+			 * \brief Show the new frame of a window
+			 *
+			 * The frame is the one composed into the image from get_present_surface
+			 * or, if there is no such image, the one drawn onto the cairo surface.
+			 */
+			virtual void present( size_t window_id ) {}
+
+			/**
+			 * \brief Show part of the last presented frame again
+			 *
+			 * Returns false if there is no such frame
+			 */
+			virtual bool present_region( size_t window_id, 
+					int x, int y, int width, int height ) { return false; }
+
 			virtual void set_title( size_t window_id, std::string title ) =0;
 			virtual void close_window( size_t window_id ) =0;
 		protected:
@@ -101,8 +138,30 @@ namespace realtimeplot {
 			size_t open_window(size_t width, size_t height,
 					boost::shared_ptr<EventHandler> pEventHandler = 
 					boost::shared_ptr<EventHandler>() );
+			/**
+			 * \brief Surface that draws onto a pixmap, which present copies to the window
+			 *
+			 * The window thus never shows half drawn frames. The pixmap is kept and
+			 * reused by later calls, unless it is too small or more than twice too big.
+			 *
+			 * Frames presented through shared memory never touch the pixmap, so then
+			 * no pixmap is made and the surface draws onto the window itself.
+			 */
 			Cairo::RefPtr<Cairo::Surface> get_cairo_surface( size_t window_id, size_t width, size_t height );
 
+			/**
+			 * \brief Image in shared memory (MIT-SHM) that present sends to the window
+			 *
+			 * Frames then never travel over the X socket. Returns an empty pointer if
+			 * the server does not support it (e.g. remote displays, other visuals)
+			 * or if the environment variable REALTIMEPLOT_NO_SHM is set.
+			 */
+			Cairo::RefPtr<Cairo::ImageSurface> get_present_surface( 
+					size_t window_id, size_t width, size_t height );
+			void present( size_t window_id );
+			bool present_region( size_t window_id, 
+					int x, int y, int width, int height );
+
 			void set_title( size_t window_id, std::string );
 			void close_window( size_t window_id );
 
@@ -110,6 +169,16 @@ namespace realtimeplot {
 			 * \brief Check if we can connect to x
 			 */
 			static bool checkXRunning();
+
+			/**
+			 * \brief Are frames presented through shared memory
+			 *
+			 * Atomic, because it is cleared under shm_mutex and read under
+			 * map_mutex.
+			 */
+			std::atomic<bool> shm_available;
+
+			friend class ::TestXcbHandler;
 		protected:
 			boost::shared_ptr<boost::thread> pXEventProcessingThrd;
 			int mask;
@@ -131,6 +200,52 @@ namespace realtimeplot {
 
 			std::map<xcb_drawable_t, boost::shared_ptr<EventHandler> > mapWindow;
 			std::map<size_t, xcb_drawable_t > mapWindowId;
+
+			/**
+			 * \brief Server side pixmap that holds the frame of a window
+			 */
+			struct BackBuffer {
+				BackBuffer() : pixmap( 0 ), width( 0 ), height( 0 ),
+					pixmap_width( 0 ), pixmap_height( 0 ) {}
+				xcb_pixmap_t pixmap;
+				xcb_gcontext_t gc;
+				//! Size in use, the pixmap itself can be larger
+				size_t width, height;
+				size_t pixmap_width, pixmap_height;
+			};
+			//! Guarded by map_mutex
+			std::map<size_t, BackBuffer> mapBackBuffer;
+			void free_back_buffer( BackBuffer &buffer );
+			//! Copy (part of) the back buffer to the window
+			bool copy_back_buffer( size_t window_id, int x, int y, int width, int height );
+
+#ifndef NO_SHM
+			/**
+			 * \brief Shared memory segment that holds the frame of a window
+			 */
+			struct ShmImage {
+				ShmImage() : data( NULL ), width( 0 ), height( 0 ), pending( false ) {}
+				xcb_shm_seg_t seg;
+				xcb_gcontext_t gc;
+				unsigned char *data;
+				size_t width, height;
+				//! Server might still be reading the last frame
+				bool pending;
+				Cairo::RefPtr<Cairo::ImageSurface> surface;
+			};
+			boost::mutex shm_mutex;
+			std::map<size_t, ShmImage> mapShm;
+
+			//! Can the server read our (RGB24) images from shared memory
+			bool check_shm();
+			bool create_shm_image( size_t window_id, ShmImage &image, 
+					size_t width, size_t height );
+			void free_shm_image( ShmImage &image );
+			//! Wait till the server is done with the last frame
+			void wait_for_shm_image( ShmImage &image );
+			void put_shm_image( size_t window_id, ShmImage &image,
+					int x, int y, int width, int height );
+#endif
 	};
 #endif
 
@@ -164,5 +279,75 @@ namespace realtimeplot {
 			~DummyHandler() {};
 	};
 
+	/**
+	 * \brief DisplayHandler that streams the shown frames to a file or pipe
+	 *
+	 * Needs no X server. Frames are composed into a ring of three images: one
+	 * being drawn, the last presented one and one being written. A writer 
+	 * thread writes the last presented frame frame_rate times per second, so
+	 * the video runs in real time and the plotting thread never waits for the
+	 * output. The output is opened by the writer thread as well, so a FIFO 
+	 * without a reader does not block the plot either.
+	 *
+	 * Paths ending in .y4m get YUV4MPEG2 (4:4:4) video, anything else raw RGBA
+	 * frames. Frames of another size than the first one are skipped, since
+	 * neither format can change size.
+	 *
+	 * Unlike the other handlers this is not a singleton, every plot gets its 
+	 * own sink.
+	 */
+	class FrameSinkHandler : public DisplayHandler {
+		public:
+			FrameSinkHandler( std::string path, double frame_rate );
+			//! Writes the last frame if it was not written yet
+			~FrameSinkHandler();
+
+			size_t open_window( size_t width, size_t height,
+					boost::shared_ptr<EventHandler> pEventHandler = 
+					boost::shared_ptr<EventHandler>() );
+
+			Cairo::RefPtr<Cairo::Surface> get_cairo_surface( size_t window_id, size_t width, size_t height );
+			Cairo::RefPtr<Cairo::ImageSurface> get_present_surface( 
+					size_t window_id, size_t width, size_t height );
+			void present( size_t window_id );
+
+			void set_title( size_t window_id, std::string title ) {}
+			/**
+			 * \brief Stops the writer thread, which writes the last frame and closes
+			 * the output
+			 *
+			 * Never blocks on a FIFO without a reader. Frames are only written once
+			 * a reader has opened it.
+			 */
+			void close_window( size_t window_id );
+
+			//! Number of frames written so far
+			size_t no_frames_written;
+
+		protected:
+			std::string path;
+			double frame_rate;
+			bool y4m;
+
+			boost::mutex ring_mutex;
+			Cairo::RefPtr<Cairo::ImageSurface> ring[3];
+			//! Index of the image being drawn, last presented and being written (-1 if none)
+			int drawing, latest, writing;
+			//! Last presented frame was not written yet
+			bool latest_new;
+			bool stop;
+			boost::shared_ptr<boost::thread> pWriterThrd;
+
+			FILE *output;
+			int width, height;
+			std::vector<unsigned char> buffer;
+			//! Straight RGBA pixels of the row being converted to YUV
+			std::vector<unsigned char> row;
+
+			void write_frames();
+			//! Returns false if the output failed, after which writing stops
+			bool write_frame( Cairo::RefPtr<Cairo::ImageSurface> frame );
+	};
+
 }
 #endif
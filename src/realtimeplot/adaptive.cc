@@ -21,16 +21,49 @@
 	 -------------------------------------------------------------------
 	 */
 
+#include <algorithm>
+
 #include "realtimeplot/adaptive.h"
 
 namespace realtimeplot {
+	namespace {
+		/**
+		 * \brief Move the bounds that the data crossed out by at least their range
+		 */
+		void grow_range( double min_data, double max_data, 
+				float &min, float &max ) {
+			double range = max-min;
+			double margin = 0.2*(max_data-min_data);
+			if (max_data > max)
+				max = std::max<double>( max_data + margin, max + range );
+			if (min_data < min)
+				min = std::min<double>( min_data - margin, min - range );
+		}
+
+		/**
+		 * \brief Wraps an event that may never be thinned out
+		 */
+		class PinnedEvent : public Event {
+			public:
+				PinnedEvent( boost::shared_ptr<Event> pEvent ) : pEvent( pEvent ) {}
+				void execute( boost::shared_ptr<BackendPlot> &pBPlot ) const {
+					pEvent->execute( pBPlot );
+				}
+			private:
+				boost::shared_ptr<Event> pEvent;
+		};
+	};
+
 	/**
 	 * Adaptive Plot
 	 */
 	BackendAdaptivePlot::BackendAdaptivePlot( PlotConfig conf,
 			boost::shared_ptr<EventHandler> pEventHandler )
 		: BackendPlot( conf, pEventHandler ), max_data_x( -1 ), max_data_y( -1 ),
-		min_data_x( 0 ), min_data_y( 0 ), adapting( true )
+		min_data_x( 0 ), min_data_y( 0 ), adapting( true ),
+		replay_pending( false ),
+		time_of_last_replay( boost::posix_time::microsec_clock::local_time() - 
+			boost::posix_time::microseconds(500000) )
 	{
 		if( config.fixed_plot_area ) {
 			adapting = false;
@@ -38,6 +71,8 @@ namespace realtimeplot {
 				convert_to_adaptive( pEventHandler )->adaptive = adapting;
 			}
 		}
+		if (pEventHandler)
+			convert_to_adaptive( pEventHandler )->keep_adapting = config.keep_adapting;
 	}
 
 	bool BackendAdaptivePlot::within_plot_bounds( float x, float y ) {
@@ -46,7 +81,8 @@ namespace realtimeplot {
 		}
 		if (adapting) {
 			// No previous points have been plotted yet
-			if (max_data_x<min_data_x) {
+			bool first = max_data_x<min_data_x;
+			if (first) {
 				max_data_x = x;
 				min_data_x = x;
 				max_data_y = y;
@@ -60,7 +96,13 @@ namespace realtimeplot {
 				max_data_y = y;
 			else if (y<min_data_y)
 				min_data_y = y;
-			adapt();
+			if (first || !BackendPlot::within_plot_bounds( x, y )) {
+				grow();
+				// Make sure the replay draws the event, even if it was thinned out
+				if (pEventHandler)
+					convert_to_adaptive( pEventHandler )->pin_current_event();
+				replay_pending = true;
+			}
 		}
 		return BackendPlot::within_plot_bounds( x, y );
 	}
@@ -70,30 +112,28 @@ namespace realtimeplot {
 		if (conf.fixed_plot_area) { 
 			adapting = false;
 			if (pEventHandler) {
-				convert_to_adaptive( pEventHandler )->processed_events.clear();
+				convert_to_adaptive( pEventHandler )->clear_processed_events();
 				convert_to_adaptive( pEventHandler )->adaptive = false;
 			}
 		}
-		// Check if no_adaptive_events was changed
-		if (config.no_adaptive_events > conf.no_adaptive_events) {
-			if (pEventHandler 
-					&& convert_to_adaptive( pEventHandler )->processed_events.size() > 
-					conf.no_adaptive_events ) {
-				convert_to_adaptive( pEventHandler )->processed_events.clear();
-				convert_to_adaptive( pEventHandler )->adaptive = false;
-				convert_to_adaptive( pEventHandler )->max_no_events = conf.no_adaptive_events;
-			}
-		} 
+		if (pEventHandler) {
+			convert_to_adaptive( pEventHandler )->keep_adapting = conf.keep_adapting;
+			// A depth below the current history stops adapting (unless 
+			// keep_adapting is set). The history itself is cleared below anyway
+			convert_to_adaptive( pEventHandler )->set_max_no_events( 
+					conf.no_adaptive_events );
+		}
 		if (adapting) {
 			max_data_x = -1;
 			max_data_y = -1;
 			min_data_x = 0;
 			min_data_y = 0;
+			// The plot is cleared, so there is nothing left to replay
 			if (pEventHandler) {
-				convert_to_adaptive( pEventHandler )->max_no_events = conf.no_adaptive_events;
-				convert_to_adaptive( pEventHandler )->processed_events.clear();
+				convert_to_adaptive( pEventHandler )->clear_processed_events();
 			}
 		}
+		replay_pending = false;
 		BackendPlot::reset( conf );
 	}
 
@@ -104,38 +144,67 @@ namespace realtimeplot {
 			min_data_x = 0;
 			min_data_y = 0;
 			if (pEventHandler) {
-				convert_to_adaptive( pEventHandler )->processed_events.clear();
+				convert_to_adaptive( pEventHandler )->clear_processed_events();
 			}
 		}
-		BackendPlot::clear();
+		if (replay_pending) {
+			// Nothing to replay, but the plot area still has the old bounds
+			replay_pending = false;
+			BackendPlot::reset( config );
+		} else {
+			BackendPlot::clear();
+		}
+	}
+
+	void BackendAdaptivePlot::display() {
+		if (replay_pending && frame_due( time_of_last_replay ))
+			redraw();
+		BackendPlot::display();
+	}
+
+	void BackendAdaptivePlot::save( std::string fn ) {
+		flush();
+		BackendPlot::save( fn );
+	}
+
+	void BackendAdaptivePlot::save_async( std::string fn, SaveCallback callback ) {
+		flush();
+		BackendPlot::save_async( fn, callback );
 	}
 
 
-	void BackendAdaptivePlot::adapt() {
+	void BackendAdaptivePlot::grow() {
 		// Only one data point
-		bool oldpause = pause_display;
-		pause_display = true;
-		if (min_data_x == max_data_x) {
+		if (min_data_x == max_data_x && min_data_y == max_data_y) {
 			config.max_x = max_data_x + 0.5;
 			config.min_x = min_data_x - 0.5;
 			config.max_y = max_data_y + 0.5;
 			config.min_y = min_data_y - 0.5;
 		} else {
-			double xrange = max_data_x-min_data_x;
-			config.max_x = max_data_x + 0.2*xrange;
-			config.min_x = min_data_x - 0.2*xrange;
-			double yrange = max_data_y-min_data_y;
-			config.max_y = max_data_y + 0.2*yrange;
-			config.min_y = min_data_y - 0.2*yrange;
+			grow_range( min_data_x, max_data_x, config.min_x, config.max_x );
+			grow_range( min_data_y, max_data_y, config.min_y, config.max_y );
 		}
+	}
+
+	void BackendAdaptivePlot::flush() {
+		if (replay_pending)
+			redraw();
+	}
+
+	void BackendAdaptivePlot::redraw() {
+		bool oldpause = pause_display;
+		pause_display = true;
+		replay_pending = false;
 		BackendPlot::reset( config ); // Don't need to reset max_data etc, 
 																	// so call parent reset
 		if (pEventHandler) {
+			bool oldadapting = adapting;
 			adapting = false;
 			convert_to_adaptive( pEventHandler )->reprocess();
-			adapting = true;
+			adapting = oldadapting;
 		}
 		pause_display = oldpause;
+		time_of_last_replay = boost::posix_time::microsec_clock::local_time();
 	}
 
 	boost::shared_ptr<AdaptiveEventHandler> BackendAdaptivePlot::convert_to_adaptive( 
@@ -148,42 +217,92 @@ namespace realtimeplot {
 	/**
 	 * Adaptive EventHandler
 	 */
-	AdaptiveEventHandler::AdaptiveEventHandler( size_t no_events ) : 
-		EventHandler(), adaptive( true ), max_no_events( no_events ) {}
+	AdaptiveEventHandler::AdaptiveEventHandler( size_t no_events, bool pooled ) : 
+		EventHandler( pooled ), adaptive( true ), keep_adapting( false ),
+		max_no_events( no_events ), stride( 1 ), no_droppable( 0 ),
+		current_kept( false ) {
+		processed_events.reserve( max_no_events );
+	}
 
 	void AdaptiveEventHandler::reprocess() {
-		boost::mutex::scoped_lock lock( proc_mutex );
-		std::list<boost::shared_ptr<Event> >::iterator it = processed_events.begin();
-		++it; // Skip openplotevent
 		if ( processing_events || !window_closed ) {
-			for (; it != processed_events.end(); ++it) {
-				(*it)->execute( pBPlot );
+			// Skip openplotevent
+			for (size_t i = 1; i < processed_events.size(); ++i) {
+				processed_events[i]->execute( pBPlot );
 			}
 		}
 	}
 
-	void AdaptiveEventHandler::process_events() {
-		while ( processing_events || !window_closed ) {
-			boost::shared_ptr<Event> pEvent = event_queue.pop();
-			if (adaptive ) {
-				boost::mutex::scoped_lock lock( proc_mutex );
-				if (processed_events.size() < max_no_events)
-					processed_events.push_back( pEvent );
-				else {
-					adaptive = false;
-					processed_events.clear();
-				}
+	void AdaptiveEventHandler::clear_processed_events() {
+		processed_events.clear();
+		stride = 1;
+		no_droppable = 0;
+	}
+
+	void AdaptiveEventHandler::set_max_no_events( size_t no_events ) {
+		while (keep_adapting && processed_events.size() > no_events && decimate()) {}
+		if (processed_events.size() > no_events) {
+			adaptive = false;
+			clear_processed_events();
+		}
+		max_no_events = no_events;
+		if (adaptive)
+			processed_events.reserve( max_no_events );
+	}
+
+	bool AdaptiveEventHandler::decimate() {
+		size_t count = 0;
+		size_t kept = 1; // Skip openplotevent
+		for (size_t i = 1; i < processed_events.size(); ++i) {
+			if (processed_events[i]->droppable() && (count++ % 2) == 1)
+				continue;
+			processed_events[kept++].swap( processed_events[i] );
+		}
+		if (count < 2)
+			return false;
+		processed_events.resize( kept );
+		stride *= 2;
+		return true;
+	}
+
+	void AdaptiveEventHandler::pin_current_event() {
+		// Non droppable events are never thinned out
+		if (!adaptive || !pCurrentEvent || !pCurrentEvent->droppable())
+			return;
+		boost::shared_ptr<Event> pPinned( new PinnedEvent( pCurrentEvent ) );
+		if (current_kept)
+			processed_events.back() = pPinned;
+		else
+			processed_events.push_back( pPinned );
+		// Pin only once, even if the event grows the region repeatedly
+		pCurrentEvent.reset();
+	}
+
+	void AdaptiveEventHandler::process_event( boost::shared_ptr<Event> pEvent ) {
+		current_kept = false;
+		if (adaptive ) {
+			if (pEvent->droppable() && (no_droppable++ % stride) != 0) {
+				// Thinned out, only drawn on the current surface
+			} else if (processed_events.size() < max_no_events
+					|| (keep_adapting && decimate() 
+						&& processed_events.size() < max_no_events)) {
+				processed_events.push_back( pEvent );
+				current_kept = true;
+			} else {
+				// Last chance to replay the kept events if an adaptation is pending
+				boost::shared_ptr<BackendAdaptivePlot> pAPlot = 
+					boost::dynamic_pointer_cast<BackendAdaptivePlot, BackendPlot>( pBPlot );
+				if (pAPlot)
+					pAPlot->flush();
+				adaptive = false;
+				clear_processed_events();
+				// Not needed any more, so give the memory back
+				std::vector<boost::shared_ptr<Event> >().swap( processed_events );
 			}
-			pEvent->execute( pBPlot );
-			if (get_queue_size() == 0) {
-				if (pBPlot != nullptr) {
-					pBPlot->display();
-				}
-			}	
 		}
-		// Make sure we let pBPlot go/freed.
-		if (pBPlot != nullptr)
-			pBPlot.reset();
+		pCurrentEvent = pEvent;
+		pEvent->execute( pBPlot );
+		pCurrentEvent.reset();
 	}
 
 };
@@ -22,12 +22,15 @@
 	 */
 
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
 #include "realtimeplot/backend.h"
 #include "realtimeplot/utils.h"
 
 #include <boost/math/special_functions/beta.hpp>
 
 #include <limits>
+#include <algorithm>
+#include <cmath>
 
 namespace realtimeplot {
 	/*
@@ -40,31 +43,43 @@ namespace realtimeplot {
 		//config = conf;
 		checkConfig();
 
+		if (!config.frame_sink.empty()) {
+			// Frames go to the sink instead of a window
+			pFrameSink = boost::shared_ptr<FrameSinkHandler>( 
+					new FrameSinkHandler( config.frame_sink, config.frame_rate ) );
+			pDisplayHandler = pFrameSink.get();
+			config.display = true;
+			if (pEventHandler != nullptr)
+				pEventHandler->window_closed = true;
+		} else {
 #ifndef NO_X
-		if (config.display && XcbHandler::checkXRunning()) 
-			pDisplayHandler = XcbHandler::Instance();
-		else {
-			if (config.display) {
-				std::cout << "Unable to connect to X. Either X is not running or the $DISPLAY variable is not set. Switched off plotting to the display." << std::endl;
-				config.display = false;
+			if (config.display && XcbHandler::checkXRunning()) 
+				pDisplayHandler = XcbHandler::Instance();
+			else {
+				if (config.display) {
+					std::cout << "Unable to connect to X. Either X is not running or the $DISPLAY variable is not set. Switched off plotting to the display." << std::endl;
+					config.display = false;
+				}
+				pDisplayHandler = DummyHandler::Instance();
+				if (pEventHandler != nullptr)
+					pEventHandler->window_closed = true;
 			}
+#endif
+#ifdef NO_X
 			pDisplayHandler = DummyHandler::Instance();
+			config.display = false;
 			if (pEventHandler != nullptr)
 				pEventHandler->window_closed = true;
-		}
-#endif
-#ifdef NO_X
-		pDisplayHandler = DummyHandler::Instance();
-		config.display = false;
-		if (pEventHandler != nullptr)
-			pEventHandler->window_closed = true;
 #endif
+		}
 
 		pPlotArea = boost::shared_ptr<PlotArea> (new PlotArea( config ));
 
 		//create_xlib_window
 		x_surface_width = pPlotArea->plot_area_width+config.left_margin+config.right_margin;
 		x_surface_height = pPlotArea->plot_area_height+config.bottom_margin+config.top_margin;
+		frame_width = 0;
+		frame_height = 0;
 		win = pDisplayHandler->open_window(x_surface_width, x_surface_height,
 				pEventHandler);
 		// Set the title
@@ -85,6 +100,9 @@ namespace realtimeplot {
 			boost::posix_time::microseconds(500000);
 
 		pause_display = false;
+		recording = false;
+		no_recorded_frames = 0;
+		pPngJobs = boost::shared_ptr<PngJobCounter>( new PngJobCounter() );
 
 		//pEventHandler->processing_events = true;
 
@@ -93,6 +111,8 @@ namespace realtimeplot {
 	}
 
 	BackendPlot::~BackendPlot() {
+		// Make sure saved files are complete when the plot is gone
+		pPngJobs->wait();
 	}
 
 	void BackendPlot::checkConfig() {
@@ -115,24 +135,81 @@ namespace realtimeplot {
 	void BackendPlot::display() {
 		//Has the display been paused?
 		if ( !pause_display && config.display && xSurface ) {
-			boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
 			//Only do this if event queue is empty 
 			//or last update was more than a 0.5 seconds ago
-			if  ((pEventHandler && pEventHandler->get_queue_size() < 1)
-					|| (( now-time_of_last_update )>( boost::posix_time::microseconds(500000))))  {
-				temporary_display_surface = create_temporary_surface();
-				//copy the temporary surface onto the xcb surface
-				//Appears that this is not completely thread safe (probably problem in xcb)
-				xContext->set_source( temporary_display_surface, 0, 0 );
-				global_mutex.lock();
-				xContext->paint();
-				global_mutex.unlock();
+			if (frame_due( time_of_last_update )) {
+				boost::posix_time::ptime now = boost::posix_time::microsec_clock::local_time();
+				Cairo::RefPtr<Cairo::ImageSurface> frame = 
+					pDisplayHandler->get_present_surface( win, 
+							pAxesArea->width, pAxesArea->height );
+				if (frame) {
+					//compose straight into the (shared memory) image of the handler
+					compose( frame );
+					if (recording)
+						record_frame( frame );
+					pDisplayHandler->present( win );
+				} else {
+					//keep composing into the same image while the size stays the same
+					if (!temporary_display_surface 
+							|| temporary_display_surface->get_width() != (int) pAxesArea->width
+							|| temporary_display_surface->get_height() != (int) pAxesArea->height)
+						temporary_display_surface = Cairo::ImageSurface::create(
+								Cairo::FORMAT_ARGB32, pAxesArea->width, pAxesArea->height );
+					compose( temporary_display_surface );
+					if (recording)
+						record_frame( temporary_display_surface );
+					//copy the temporary surface onto the xcb surface (the back buffer 
+					//of the window) and show it in one go
+					//Appears that this is not completely thread safe (probably problem in xcb)
+					xContext->set_source( temporary_display_surface, 0, 0 );
+					global_mutex.lock();
+					xContext->paint();
+					xSurface->flush();
+					global_mutex.unlock();
+					pDisplayHandler->present( win );
+				}
 
+				frame_width = pAxesArea->width;
+				frame_height = pAxesArea->height;
 				time_of_last_update = now;
 			}
 		}
 	}
 
+	void BackendPlot::display_region( int x, int y, int width, int height ) {
+		if ( !config.display || !xSurface )
+			return;
+		if (frame_width != (int) pAxesArea->width 
+				|| frame_height != (int) pAxesArea->height) {
+			// The last frame is gone or stale, so compose a new one right away
+			time_of_last_update = boost::posix_time::microsec_clock::local_time() - 
+				boost::posix_time::microseconds(500000);
+			display();
+			return;
+		}
+		if (pDisplayHandler->present_region( win, x, y, width, height ))
+			return;
+		if (!temporary_display_surface) {
+			display();
+			return;
+		}
+		global_mutex.lock();
+		xContext->save();
+		xContext->rectangle( x, y, width, height );
+		xContext->clip();
+		xContext->set_source( temporary_display_surface, 0, 0 );
+		xContext->paint();
+		xContext->restore();
+		global_mutex.unlock();
+	}
+
+	bool BackendPlot::frame_due( const boost::posix_time::ptime &since ) {
+		if (pEventHandler && pEventHandler->get_queue_size() < 1)
+			return true;
+		return ( boost::posix_time::microsec_clock::local_time()-since ) >
+			boost::posix_time::microseconds(500000);
+	}
+
 	void BackendPlot::clear() {
 		//give the plot its background color
 		pPlotArea->clear();
@@ -145,15 +222,21 @@ namespace realtimeplot {
 		pPlotArea->setup( conf );
 		global_mutex.unlock();
 		set_foreground_color();
+		int old_width = x_surface_width;
+		int old_height = x_surface_height;
 		if (!config.scaling) { 
 			// If no scaling then adapt current size to new size
 			// otherwise just use current sizes when setting xsurface etc
 			x_surface_width = pPlotArea->plot_area_width+config.left_margin+config.right_margin;
 			x_surface_height = pPlotArea->plot_area_height+config.bottom_margin+config.top_margin;
 		}
-		xSurface = pDisplayHandler->get_cairo_surface( win, 
-				x_surface_width, x_surface_height );
-		xContext = Cairo::Context::create( xSurface );
+		// Only a change in size needs a new xsurface
+		if (!xSurface || old_width != x_surface_width 
+				|| old_height != x_surface_height) {
+			xSurface = pDisplayHandler->get_cairo_surface( win, 
+					x_surface_width, x_surface_height );
+			xContext = Cairo::Context::create( xSurface );
+		}
 
 		//draw initial axes etc
 		draw_axes_surface();
@@ -249,6 +332,32 @@ namespace realtimeplot {
 		display();
 	}
 
+	void BackendPlot::grid( float min_x, float min_y, float width_x, float width_y,
+			size_t no_x, size_t no_y, const std::vector<uint32_t> &colors ) {
+		if (!within_plot_bounds(min_x,min_y)) {
+			if (!config.fixed_plot_area)
+				rolling_update(min_x, min_y);
+		}
+
+		Cairo::RefPtr<Cairo::ImageSurface> image = 
+			Cairo::ImageSurface::create( Cairo::FORMAT_ARGB32, no_x, no_y );
+		image->flush();
+		unsigned char *pixels = image->get_data();
+		int stride = image->get_stride();
+		// Image rows run from top to bottom, so highest y first
+		for (size_t y=0; y<no_y; ++y) {
+			uint32_t *row = reinterpret_cast<uint32_t*>( pixels + (no_y-1-y)*stride );
+			for (size_t x=0; x<no_x; ++x)
+				row[x] = colors[x*no_y+y];
+		}
+		image->mark_dirty();
+
+		global_mutex.lock();
+		pPlotArea->image( image, min_x, min_y, no_x*width_x, no_y*width_y );
+		global_mutex.unlock();
+		display();
+	}
+
 	void BackendPlot::line_add( float x, float y ) {
 		if (!within_plot_bounds(x,y)) {
 			if (!config.fixed_plot_area)
@@ -323,6 +432,56 @@ namespace realtimeplot {
 		pSurface->write_to_png( fn );
 	}
 
+	void BackendPlot::save_async( std::string fn, SaveCallback callback ) {
+		// Compose straight into the buffer of the image, so the writer gets its 
+		// own copy without an extra memcpy
+		boost::shared_ptr<PngImage> pImage( 
+				new PngImage( pAxesArea->width, pAxesArea->height ) );
+		{
+			Cairo::RefPtr<Cairo::ImageSurface> surface = Cairo::ImageSurface::create( 
+					&pImage->data[0], Cairo::FORMAT_ARGB32, 
+					pImage->width, pImage->height, pImage->stride );
+			compose( surface );
+			surface->finish();
+		}
+		PngWriter::Instance()->add( pImage, fn, config.png_compression_level,
+				config.png_filters, callback, false, pPngJobs );
+	}
+
+	void BackendPlot::record( bool on ) {
+		recording = on;
+		if (recording)
+			display();
+	}
+
+	boost::shared_ptr<PngImage> BackendPlot::snapshot( 
+			Cairo::RefPtr<Cairo::ImageSurface> frame ) {
+		frame->flush();
+		boost::shared_ptr<PngImage> pImage( 
+				new PngImage( frame->get_width(), frame->get_height() ) );
+		const unsigned char *data = frame->get_data();
+		for (int j = 0; j < pImage->height; ++j)
+			std::copy( data + j*frame->get_stride(), 
+					data + j*frame->get_stride() + pImage->stride,
+					pImage->data.begin() + j*pImage->stride );
+		// Shared memory images have no alpha channel, treat them as opaque
+		if (frame->get_format() == Cairo::FORMAT_RGB24) {
+			uint32_t *pixels = (uint32_t *) &pImage->data[0];
+			for (size_t i = 0; i < pImage->data.size()/4; ++i)
+				pixels[i] |= 0xff000000;
+		}
+		return pImage;
+	}
+
+	void BackendPlot::record_frame( Cairo::RefPtr<Cairo::ImageSurface> frame ) {
+		char fn[32];
+		snprintf( fn, sizeof( fn ), "realtimeplot_%05zu.png", no_recorded_frames );
+		if (PngWriter::Instance()->add( snapshot( frame ), fn, 
+					config.png_compression_level, config.png_filters, 
+					SaveCallback(), true, pPngJobs ))
+			++no_recorded_frames;
+	}
+
 	void BackendPlot::rolling_update( float x, float y ) {
 		std::vector<int> direction;
 		direction.push_back( 0 );
@@ -380,10 +539,15 @@ namespace realtimeplot {
 	 * directly onto xlibsurface
 	 */
 	Cairo::RefPtr<Cairo::ImageSurface> BackendPlot::create_temporary_surface() {
-		global_mutex.lock();
 		Cairo::RefPtr<Cairo::ImageSurface> surface = 
 			Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, 
 					pAxesArea->width, pAxesArea->height );
+		compose( surface );
+		return surface;
+	}
+
+	void BackendPlot::compose( Cairo::RefPtr<Cairo::ImageSurface> surface ) {
+		global_mutex.lock();
 		Cairo::RefPtr<Cairo::Context> context = Cairo::Context::create( surface );
 
 		double x = pPlotArea->min_x;
@@ -408,7 +572,6 @@ namespace realtimeplot {
 		context->set_source( pAxesArea->surface, 0, 0 );
 		context->paint();
 		global_mutex.unlock();
-		return surface;
 	}
 
 	void BackendPlot::move_pixels( int pixels_x, int pixels_y ) {
@@ -563,6 +726,11 @@ namespace realtimeplot {
 		}
 		xContext = Cairo::Context::create( xSurface );
 		draw_axes_surface();
+
+		// Show the new size now, instead of waiting for the next plotted data
+		time_of_last_update = boost::posix_time::microsec_clock::local_time() - 
+			boost::posix_time::microseconds(500000);
+		display();
 	}
 
 	/*
@@ -572,7 +740,9 @@ namespace realtimeplot {
 	BackendHistogram::BackendHistogram( PlotConfig conf, bool frequency, 
 			size_t no_bins, boost::shared_ptr<EventHandler> pEventHandler ) 
 		: BackendPlot( conf, pEventHandler ), no_bins( no_bins ), 
-		frequency( frequency ), rebin( false )
+		frequency( frequency ), rebin( false ), no_series( 1 ), 
+		series_size( 1 ), stacked( false ), windowed( false ),
+		window_in_seconds( false ), no_samples_seen( 0 )
 	{
 		config.min_y = 0;
 		config.max_y = 1.2;
@@ -582,7 +752,7 @@ namespace realtimeplot {
 			rebin = true;
 		}
 		reset( config );
-		bins_y = utils::calculate_bins( config.min_x, config.max_x, no_bins, data );
+		bin_data();
 	}
 
 	double BackendHistogram::bin_width() {
@@ -613,8 +783,36 @@ namespace realtimeplot {
 			return data_min + 0.5;
 	}
 
-	void BackendHistogram::add_data( double new_data ) {
+	void BackendHistogram::add_series( size_t new_no_series ) {
+		if (new_no_series <= no_series)
+			return;
+		no_series = new_no_series;
+		// Series are stored one after the other, so existing counts stay in place
+		series_bins.resize( no_series*no_bins );
+		series_size.resize( no_series );
+		if (windowed)
+			window.resize( no_series*no_bins );
+	}
+
+	void BackendHistogram::add_data( double new_data, size_t series ) {
+		add_series( series+1 );
+		if (windowed) {
+			double clock = window_clock();
+			++no_samples_seen;
+			if (new_data>=min() && new_data<max()) {
+				size_t id = utils::bin_id(min(), bin_width(), new_data);
+				if (id<no_bins) {
+					window.add( series*no_bins+id, clock );
+					return;
+				}
+			}
+			window.advance( clock );
+			return;
+		}
+
 		data.push_back( new_data );
+		data_series.push_back( series );
+		++series_size[series];
 		if (data.size() == 1) {
 			data_min = data[0];
 			data_max = data_min;
@@ -632,25 +830,49 @@ namespace realtimeplot {
 		if (!rebin && new_data>=min() && new_data<max()) {
 			size_t id = utils::bin_id(min(), bin_width(), new_data);
 			++bins_y[id];
+			++series_bins[series*no_bins+id];
 			if (!frequency && bins_y[id]>config.max_y)
 				config.max_y = bins_y[id]*1.2;
 		}
 	}
 
 	void BackendHistogram::rebin_data() {
-		bins_y = utils::calculate_bins( min(), max(), no_bins, data );
+		bin_data();
+		update_max_y( bins_y );
+		rebin = false;
+	}
+
+	void BackendHistogram::bin_data() {
+		bins_y.assign( no_bins, 0 );
+		series_bins.assign( no_series*no_bins, 0 );
+		double lower = min();
+		double upper = max();
+		double width = bin_width();
+		for (size_t i=0; i<data.size(); ++i) {
+			if (data[i]>=lower && data[i]<upper) {
+				size_t id = utils::bin_id( lower, width, data[i] );
+				if (id<no_bins) {
+					++bins_y[id];
+					++series_bins[data_series[i]*no_bins+id];
+				}
+			}
+		}
+	}
 
+	void BackendHistogram::update_max_y( const std::vector<double> &counts ) {
 		config.max_y = 1.2;
 		if (!frequency) {
-			for (size_t i=0; i<no_bins; ++i) {
-				if (bins_y[i] > config.max_y)
-					config.max_y = 1.2*bins_y[i];
+			for (size_t i=0; i<counts.size(); ++i) {
+				if (counts[i] > config.max_y)
+					config.max_y = 1.2*counts[i];
 			}
 		}
-		rebin = false;
 	}
 
 	void BackendHistogram::optimize_bounds( double proportion ) {
+		// Bin edges are frozen and no data is kept while windowed
+		if (windowed)
+			return;
 		//Start fresh
 		config.fixed_plot_area = false;
 		rebin_data();
@@ -677,15 +899,62 @@ namespace realtimeplot {
 		if (config.max_x > data_max ) {
 			double x = 0.1; // max-x*bin_width = data_max
 			config.max_x = (config.min_x*x+data_max*x-data_max*no_bins)/(2*x-no_bins);
-			bins_y = utils::calculate_bins( min(), max(), no_bins, data );
 		}
-		config.max_y = 1.2;
-		if (!frequency) {
-			for (size_t i=0; i<no_bins; ++i) {
-				if (bins_y[i] > config.max_y)
-					config.max_y = 1.2*bins_y[i];
+		bin_data();
+		update_max_y( bins_y );
+	}
+
+	void BackendHistogram::sliding_window( double length, size_t no_slices,
+			bool in_seconds ) {
+		// No (or a NaN) length means no window, the rotation period would be 0
+		if (!(length > 0))
+			return;
+		no_slices = std::max<size_t>( 1, no_slices );
+		window_in_seconds = in_seconds;
+		window.set_sliding( no_series*no_bins, no_slices, length/no_slices );
+		start_window();
+	}
+
+	void BackendHistogram::decaying_window( double half_life, size_t no_steps,
+			bool in_seconds ) {
+		if (!(half_life > 0))
+			return;
+		no_steps = std::max<size_t>( 1, no_steps );
+		window_in_seconds = in_seconds;
+		window.set_decaying( no_series*no_bins, pow( 0.5, 1.0/no_steps ), 
+				half_life/no_steps );
+		start_window();
+	}
+
+	void BackendHistogram::start_window() {
+		if (!config.fixed_plot_area) {
+			config.min_x = min();
+			config.max_x = max();
+			config.fixed_plot_area = true;
+		}
+		rebin = false;
+		windowed = true;
+		no_samples_seen = 0;
+		window_start = boost::posix_time::microsec_clock::local_time();
+
+		// Data added so far becomes the first part of the window
+		double width = bin_width();
+		for (size_t i=0; i<data.size(); ++i) {
+			if (data[i]>=min() && data[i]<max()) {
+				size_t id = utils::bin_id( min(), width, data[i] );
+				if (id<no_bins)
+					window.add( data_series[i]*no_bins+id, 0 );
 			}
 		}
+		data.clear();
+		data_series.clear();
+	}
+
+	double BackendHistogram::window_clock() {
+		if (window_in_seconds)
+			return (boost::posix_time::microsec_clock::local_time()-window_start)
+				.total_microseconds()*1e-6;
+		return no_samples_seen;
 	}
 
 	void BackendHistogram::plot() {
@@ -693,6 +962,25 @@ namespace realtimeplot {
 		if (rebin) {
 			rebin_data();
 		}
+		double total = data.size();
+		if (windowed) {
+			window.advance( window_clock() );
+			series_bins = window.bins();
+			total = window.total();
+			bins_y.assign( no_bins, 0 );
+			series_size.assign( no_series, 0 );
+			for (size_t s=0; s<no_series; ++s) {
+				for (size_t i=0; i<no_bins; ++i) {
+					bins_y[i] += series_bins[s*no_bins+i];
+					series_size[s] += series_bins[s*no_bins+i];
+				}
+			}
+			update_max_y( bins_y );
+		}
+		// Overlaid series only need to fit the biggest series
+		if (!stacked && no_series>1 && !frequency)
+			update_max_y( series_bins );
+
 		if (!config.fixed_plot_area) {
 			config.min_x = min() - 0.5*width;
 			config.max_x = max() + 0.5*width;
@@ -700,14 +988,34 @@ namespace realtimeplot {
 		bool before = pause_display;
 		pause_display = true; // Don't draw while updating the screen
 		reset( config );
-		for (size_t i=0; i<no_bins; ++i) {
-			double height = bins_y[i];
-			if (frequency && data.size()>0)
-				height/=data.size();
-			line_add( min()+i*width, 0, -1, Color::black() );
-			line_add( min()+i*width, height, -1, Color::black() );
-			line_add( min()+(i+1)*width, height, -1, Color::black() );
-			line_add( min()+(i+1)*width, 0, -1, Color::black() );
+		if (stacked) {
+			std::vector<double> base( no_bins );
+			for (size_t s=0; s<no_series; ++s) {
+				for (size_t i=0; i<no_bins; ++i) {
+					double height = series_bins[s*no_bins+i];
+					if (frequency && total>0)
+						height/=total;
+					if (height>0)
+						rectangle( min()+i*width, base[i], width, height, true,
+								Color::by_id( s ) );
+					base[i] += height;
+				}
+			}
+		} else {
+			for (size_t s=0; s<no_series; ++s) {
+				// Every series gets its own line
+				int id = -1-s;
+				Color color = Color::by_id( s );
+				for (size_t i=0; i<no_bins; ++i) {
+					double height = series_bins[s*no_bins+i];
+					if (frequency && series_size[s]>0)
+						height/=series_size[s];
+					line_add( min()+i*width, 0, id, color );
+					line_add( min()+i*width, height, id, color );
+					line_add( min()+(i+1)*width, height, id, color );
+					line_add( min()+(i+1)*width, 0, id, color );
+				}
+			}
 		}
 		pause_display = before;
 		display();
@@ -865,14 +1173,13 @@ namespace realtimeplot {
 		bool before = pause_display;
 		pause_display = true; // Don't draw while updating the screen
 		reset( config );
-		for (size_t x = 0; x<no_bins_x; ++x) {
-			for (size_t y = 0; y<no_bins_y; ++y) {
-				Color color = color_map( 
-							((double) bins_xy[xytoindex(x,y)])/max_z );
-				rectangle( min_x()+width_x*x, min_y()+width_y*y, 
-						width_x, width_y, true, color );
-			}
-		}
+		// Cells are stored as x*no_bins_y+y, which is the layout grid expects
+		std::vector<double> fractions( bins_xy.size() );
+		for (size_t i = 0; i<bins_xy.size(); ++i)
+			fractions[i] = ((double) bins_xy[i])/max_z;
+		std::vector<uint32_t> colors;
+		color_map.argb32( fractions, colors );
+		grid( min_x(), min_y(), width_x, width_y, no_bins_x, no_bins_y, colors );
 		pause_display = before;
 		display();
 	}
@@ -904,56 +1211,6 @@ namespace realtimeplot {
 		plot();
 	}
 
-
-	std::vector<boost::shared_ptr<Vertex3D> > Triangle3D::gradientVector() {
-				std::vector<boost::shared_ptr<Vertex3D> > v;
-				//Find lowest and highest Vertex
-				v.push_back( boost::shared_ptr<Vertex3D>( new Vertex3D( vertices[0]->x, 
-								vertices[0]->y, vertices[0]->z ) ) );
-				v.push_back( boost::shared_ptr<Vertex3D>( new Vertex3D( vertices[1]->x, 
-								vertices[1]->y, vertices[1]->z ) ) );
-
-				for (size_t i=0; i<3; ++i) {
-					if (vertices[i]->z < v[0]->z)
-						v[0].reset( new Vertex3D( vertices[i]->x, vertices[i]->y, vertices[i]->z ) );
-					if (vertices[i]->z > v[1]->z)
-						v[1].reset( new Vertex3D( vertices[i]->x, vertices[i]->y, vertices[i]->z ) );
-				}
-
-				// Flat, so the vector should be flat as well
-				if (v[0]->z == v[1]->z) {
-					v[0]->z = 0;
-					v[1]->z = 0;
-					return v;
-				}
-
-				boost::shared_ptr<Vertex3D> pEV1( new Vertex3D( vertices[1]->x-vertices[0]->x,
-							vertices[1]->y-vertices[0]->y,
-							vertices[1]->z-vertices[0]->z ) );
-				boost::shared_ptr<Vertex3D> pEV2( new Vertex3D( vertices[2]->x-vertices[0]->x,
-							vertices[2]->y-vertices[0]->y,
-							vertices[2]->z-vertices[0]->z ) );
-				float x2; float y2; float z2;
-				boost::shared_ptr<Vertex3D> pNormal;
-				pNormal = pEV1->crossProduct( pEV2 );
-				if (pNormal->x == 0) {
-					x2 = pNormal->x/pNormal->y;
-					y2 = 1;
-					z2 = -(pow(pNormal->y,2)+pow(pNormal->x,2))/(pNormal->y*pNormal->z);
-				} else {
-					x2 = 1;
-					y2 = pNormal->y/pNormal->x;
-					z2 = -(pow(pNormal->y,2)+pow(pNormal->x,2))/(pNormal->x*pNormal->z);
-				}
-
-				float scalar = (v[1]->z-v[0]->z)/z2;
-				v[1]->x = v[0]->x+scalar*x2;
-				v[1]->y = v[0]->y+scalar*y2;
-				v[1]->z = v[0]->z+scalar*z2;
-				return v;
-			}
-
-
 	/*
 	 * HeightMap
 	 */
@@ -962,81 +1219,356 @@ namespace realtimeplot {
 		BackendPlot( cfg, pEventHandler ),
 		zmin( 0 ), zmax( 0 ),
 		delaunay( delaunay::Delaunay( config.min_x, 
-					config.max_x, config.min_y, config.max_y ) )
-	{}
+					config.max_x, config.min_y, config.max_y ) ),
+		heights( 3, 0 ),
+		needs_full_redraw( false ),
+		contours_valid( false ),
+		window_max_points( 0 ), window_max_age( 0 )
+	{
+		clear_dirty();
+	}
 
 
 	void BackendHeightMap::add_data( float x, float y, float z, bool show) {
-		if (delaunay.vertices.size() == 0) {
+		// Colors of all triangles depend on zmin and zmax
+		bool redraw_all = false;
+		if (heights.size() == 3) {
 			zmin = z;
 			zmax = z;
+			redraw_all = true;
 		}
-		if (z<zmin)
+		if (z<zmin) {
 			zmin = z;
-		else if (z>zmax)
+			redraw_all = true;
+		} else if (z>zmax) {
 			zmax = z;
-		boost::shared_ptr<delaunay::Vertex> vertex( new Vertex3D( x, y, z ) );
-		delaunay.add_data( vertex );
-		if (show && delaunay.vertices.size()>=3)
+			redraw_all = true;
+		}
+		size_t no_vertices = delaunay.noVertices();
+		uint32_t v = delaunay.add_data( delaunay::Vertex( x, y ) );
+		if (v >= heights.size())
+			heights.resize( v+1 );
+		heights[v] = z;
+		// Existing vertex, its height has been replaced
+		if (delaunay.noVertices() == no_vertices) {
+			redraw_all = true;
+			contours_valid = false;
+		}
+		window_add( v );
+		if (expire())
+			redraw_all = true;
+		if (!show) {
+			// Hidden changes (and a changed z range) are drawn by the next shown
+			// update, which redraws everything
+			needs_full_redraw = true;
+			delaunay.changedTriangles.clear();
+			clear_dirty();
+			contours_valid = false;
+			return;
+		}
+		if (redraw_all || needs_full_redraw)
+			plot();
+		else
+			plot_changed();
+	}
+
+
+
+	void BackendHeightMap::set_data( const std::vector<float> &xs, 
+			const std::vector<float> &ys, const std::vector<float> &zs, bool show ) {
+		size_t n = std::min( xs.size(), std::min( ys.size(), zs.size() ) );
+		if (n == 0)
+			return;
+		if (heights.size() == 3) {
+			zmin = zs[0];
+			zmax = zs[0];
+		}
+		std::vector<delaunay::Vertex> batch;
+		batch.reserve( n );
+		for (size_t i=0; i<n; ++i) {
+			batch.push_back( delaunay::Vertex( xs[i], ys[i] ) );
+			if (zs[i]<zmin)
+				zmin = zs[i];
+			else if (zs[i]>zmax)
+				zmax = zs[i];
+		}
+		std::vector<uint32_t> ids;
+		// Building an empty triangulation from scratch only pays off when its
+		// recursion can be spread over several cores. On one core incremental
+		// insertion is faster
+		if (delaunay.noVertices() == 3
+				&& boost::thread::hardware_concurrency() > 1)
+			ids = delaunay.triangulate( batch );
+		else
+			ids = delaunay.add_data( batch );
+		heights.resize( delaunay.vertices.size() );
+		for (size_t i=0; i<n; ++i) {
+			heights[ids[i]] = zs[i];
+			window_add( ids[i] );
+		}
+		expire();
+		// Heights of existing vertices can have changed
+		contours_valid = false;
+		if (show)
 			plot();
+		else {
+			// Drawn by the next shown update
+			needs_full_redraw = true;
+			delaunay.changedTriangles.clear();
+			clear_dirty();
+		}
 	}
 
+	void BackendHeightMap::sliding_window( size_t max_points, double max_age ) {
+		window_max_points = max_points;
+		window_max_age = max_age;
+		if (window_max_points == 0 && window_max_age <= 0) {
+			window.clear();
+			in_window.clear();
+			return;
+		}
+		// Points that are already in the map will be the first to go
+		std::vector<bool> free( delaunay.vertices.size(), false );
+		for (auto & v : delaunay.freeVertices)
+			free[v] = true;
+		for (uint32_t v=3; v<delaunay.vertices.size(); ++v) {
+			if (!free[v])
+				window_add( v );
+		}
+		if (expire())
+			plot();
+		else
+			plot_changed();
+	}
 
+	void BackendHeightMap::window_add( uint32_t v ) {
+		if (window_max_points == 0 && window_max_age <= 0)
+			return;
+		if (v >= in_window.size())
+			in_window.resize( v+1, false );
+		if (in_window[v])
+			return;
+		in_window[v] = true;
+		window.push_back( std::pair<uint32_t, boost::posix_time::ptime>( v,
+					boost::posix_time::microsec_clock::universal_time() ) );
+	}
+
+	bool BackendHeightMap::expire() {
+		if (window.empty())
+			return false;
+		boost::posix_time::ptime cutoff = 
+			boost::posix_time::microsec_clock::universal_time() - 
+			boost::posix_time::microseconds( (int64_t) (window_max_age*1e6) );
+		bool extreme_removed = false;
+		while (!window.empty() && 
+				((window_max_points > 0 && window.size() > window_max_points) ||
+				 (window_max_age > 0 && window.front().second < cutoff))) {
+			uint32_t v = window.front().first;
+			window.pop_front();
+			in_window[v] = false;
+			// Its triangles can lie outside of the new hull, so clear their area
+			mark_dirty( delaunay.vertices[v] );
+			delaunay.remove_data( v );
+			if (heights[v] <= zmin || heights[v] >= zmax)
+				extreme_removed = true;
+			// Excluded from the height scaling until the vertex is reused
+			heights[v] = std::numeric_limits<float>::quiet_NaN();
+		}
+		if (!extreme_removed)
+			return false;
+
+		// Shrink the range of heights to the remaining points
+		float new_zmin = std::numeric_limits<float>::infinity();
+		float new_zmax = -std::numeric_limits<float>::infinity();
+		for (size_t i=3; i<heights.size(); ++i) {
+			if (std::isnan( heights[i] ))
+				continue;
+			new_zmin = std::min( new_zmin, heights[i] );
+			new_zmax = std::max( new_zmax, heights[i] );
+		}
+		if (new_zmin > new_zmax || (new_zmin == zmin && new_zmax == zmax))
+			return false;
+		zmin = new_zmin;
+		zmax = new_zmax;
+		return true;
+	}
 
 	void BackendHeightMap::plot() {
 		// Only display it after it has been drawn completely
 		bool before = pause_display;
 		pause_display = true; // Don't draw while updating the screen
 		clear();
-		for (size_t i=0; i<delaunay.triangles.size(); ++i) {
-			bool part_of_super = false;
-			for (size_t j=0; j<3; ++j) {
-				for (size_t k=0; k<3; ++k) {
-					if (delaunay.triangles[i]->corners[j]->vertex == delaunay.vertices[k])
-						part_of_super = true;
-				}
+		std::vector<uint32_t> triangles( delaunay.noTriangles() );
+		for (uint32_t i=0; i<delaunay.noTriangles(); ++i)
+			triangles[i] = i;
+		draw_triangles( triangles );
+		if (!contour_levels.empty()) {
+			if (contours_valid) {
+				extract_contours( delaunay.changedTriangles );
+			} else {
+				extract_contours( triangles );
+				contours_valid = true;
 			}
+			draw_contours( triangles );
+		}
+		delaunay.changedTriangles.clear();
+		clear_dirty();
+		needs_full_redraw = false;
+
+		pause_display = before;
+		display();
+	}
+
+	void BackendHeightMap::plot_changed() {
+		// Stale contour segments outside of the changed triangles would be drawn
+		// as well, so all of them have to be extracted again
+		if (needs_full_redraw || (!contours_valid && !contour_levels.empty())) {
+			plot();
+			return;
+		}
+		std::vector<uint32_t> &changed = delaunay.changedTriangles;
+		std::sort( changed.begin(), changed.end() );
+		changed.erase( std::unique( changed.begin(), changed.end() ), changed.end() );
+		for (auto & t : changed) {
+			if (delaunay.isDeleted( t ))
+				continue;
+			for (uint32_t c=3*t; c<3*t+3; ++c) {
+				if (delaunay.corners[c] >= 3)
+					mark_dirty( delaunay.vertex( c ) );
+			}
+		}
+		if (dirty_min.x <= dirty_max.x) {
+			std::vector<uint32_t> redraw = triangles_in_dirty_box( changed );
+			pPlotArea->clear( dirty_min.x, dirty_min.y, 
+					dirty_max.x-dirty_min.x, dirty_max.y-dirty_min.y );
+			draw_triangles( redraw );
+			if (!contour_levels.empty()) {
+				extract_contours( changed );
+				draw_contours( redraw );
+			}
+		}
+		changed.clear();
+		clear_dirty();
+		display();
+	}
+
+	void BackendHeightMap::clear_dirty() {
+		dirty_min = delaunay::Vertex( std::numeric_limits<float>::infinity(), 
+				std::numeric_limits<float>::infinity() );
+		dirty_max = delaunay::Vertex( -std::numeric_limits<float>::infinity(), 
+				-std::numeric_limits<float>::infinity() );
+	}
+
+	void BackendHeightMap::mark_dirty( const delaunay::Vertex &vertex ) {
+		dirty_min.x = std::min( dirty_min.x, vertex.x );
+		dirty_min.y = std::min( dirty_min.y, vertex.y );
+		dirty_max.x = std::max( dirty_max.x, vertex.x );
+		dirty_max.y = std::max( dirty_max.y, vertex.y );
+	}
+
+	std::vector<uint32_t> BackendHeightMap::triangles_in_dirty_box( 
+			const std::vector<uint32_t> &changed ) {
+		visited.resize( delaunay.noTriangles(), false );
+		std::vector<uint32_t> found; // All visited triangles
+		std::vector<uint32_t> redraw;
+		std::vector<uint32_t> todo;
+		// Changed triangles can lie outside of the data (after removing a vertex
+		// on the hull), their neighbours then still lead into the box
+		for (auto & t : changed) {
+			if (delaunay.isDeleted( t ))
+				continue;
+			todo.push_back( t );
+			for (uint32_t c=3*t; c<3*t+3; ++c) {
+				if (delaunay.opposites[c] != delaunay::noCorner)
+					todo.push_back( delaunay::Delaunay::triangle( delaunay.opposites[c] ) );
+			}
+		}
+		while (!todo.empty()) {
+			uint32_t t = todo.back();
+			todo.pop_back();
+			if (visited[t])
+				continue;
+			visited[t] = true;
+			found.push_back( t );
+			// Part of the super triangle, not drawn
+			const std::vector<uint32_t> &corners = delaunay.corners;
+			if (corners[3*t] < 3 || corners[3*t+1] < 3 || corners[3*t+2] < 3)
+				continue;
+			const delaunay::Vertex &a = delaunay.vertex( 3*t );
+			const delaunay::Vertex &b = delaunay.vertex( 3*t+1 );
+			const delaunay::Vertex &c = delaunay.vertex( 3*t+2 );
+			if (std::max( a.x, std::max( b.x, c.x ) ) < dirty_min.x ||
+					std::min( a.x, std::min( b.x, c.x ) ) > dirty_max.x ||
+					std::max( a.y, std::max( b.y, c.y ) ) < dirty_min.y ||
+					std::min( a.y, std::min( b.y, c.y ) ) > dirty_max.y)
+				continue;
+			redraw.push_back( t );
+			for (uint32_t i=3*t; i<3*t+3; ++i) {
+				if (delaunay.opposites[i] != delaunay::noCorner)
+					todo.push_back( delaunay::Delaunay::triangle( delaunay.opposites[i] ) );
+			}
+		}
+		for (auto & t : found)
+			visited[t] = false;
+		return redraw;
+	}
 
-			if (!part_of_super) {
-				Triangle3D tr = Triangle3D( delaunay.triangles[i] );
-				std::vector<boost::shared_ptr<Vertex3D> > v = tr.gradientVector();
-
-				double x0 = v[0]->x;
-				double y0 = v[0]->y;
-				double x1 = v[1]->x;
-				double y1 = v[1]->y;
-				//plot_context->user_to_device( x0, y0 );
-				//plot_context->user_to_device( x1, y1 );
-
-				Cairo::RefPtr< Cairo::LinearGradient > pGradient = Cairo::LinearGradient::create(
-						x0, y0, x1, y1 );
-
-				Color shade = colorMap( v[0]->z );
-				pGradient->add_color_stop_rgba( 0, shade.r, shade.g, shade.b, shade.a ); 
-				shade = colorMap( v[1]->z );
-				pGradient->add_color_stop_rgba( 1, shade.r, shade.g, shade.b, shade.a ); 
-				pPlotArea->transform_to_plot_units();
-				pPlotArea->context->move_to( tr.vertices[2]->x, tr.vertices[2]->y );
-
-				for (size_t j=0; j<3; ++j) {
-					pPlotArea->context->line_to( tr.vertices[j]->x, tr.vertices[j]->y );
+	void BackendHeightMap::contours( const std::vector<float> &levels, 
+			Color color ) {
+		contour_levels = levels;
+		contour_color = color;
+		contour_segments.assign( levels.size(), std::vector<delaunay::Vertex>() );
+		contours_valid = false;
+		plot();
+	}
+
+	void BackendHeightMap::extract_contours( const std::vector<uint32_t> &triangles ) {
+		float nan = std::numeric_limits<float>::quiet_NaN();
+		for (size_t i=0; i<contour_levels.size(); ++i) {
+			std::vector<delaunay::Vertex> &segments = contour_segments[i];
+			segments.resize( 2*delaunay.noTriangles(), delaunay::Vertex( nan, nan ) );
+			for (auto & t : triangles) {
+				if (delaunay.isDeleted( t ) || delaunay.corners[3*t] < 3 || 
+						delaunay.corners[3*t+1] < 3 || delaunay.corners[3*t+2] < 3 ||
+						!delaunay.contourSegment( t, heights, contour_levels[i],
+							segments[2*t], segments[2*t+1] )) {
+					segments[2*t] = delaunay::Vertex( nan, nan );
 				}
-				pPlotArea->context->set_source( pGradient );
-				pPlotArea->transform_to_device_units();
-				pPlotArea->context->fill_preserve();
-				pPlotArea->context->stroke();
-				//line_add( delaunay.triangles[i]->corners[0]->vertex->x,
-				//delaunay.triangles[i]->corners[0]->vertex->y, i, Color::red() );
 			}
 		}
+	}
 
-		pause_display = before;
-		display();
+	void BackendHeightMap::draw_contours( const std::vector<uint32_t> &triangles ) {
+		std::vector<delaunay::Vertex> ends;
+		for (auto & segments : contour_segments) {
+			ends.clear();
+			for (auto & t : triangles) {
+				// Segments of removed triangles are left behind in the cache
+				if (2*t < segments.size() && !delaunay.isDeleted( t ) &&
+						!std::isnan( segments[2*t].x )) {
+					ends.push_back( segments[2*t] );
+					ends.push_back( segments[2*t+1] );
+				}
+			}
+			pPlotArea->segments( ends, contour_color );
+		}
 	}
 
-	Color BackendHeightMap::colorMap( float z ) {
-		float fraction = (z-zmin)/(zmax-zmin);
-		return color_map( fraction );
+	void BackendHeightMap::draw_triangles( const std::vector<uint32_t> &triangles ) {
+		std::vector<uint32_t> indices;
+		indices.reserve( 3*triangles.size() );
+		for (auto & t : triangles) {
+			if (delaunay.isDeleted( t ))
+				continue;
+			// The first three vertices make up the super triangle
+			if (delaunay.corners[3*t] < 3 || delaunay.corners[3*t+1] < 3 ||
+					delaunay.corners[3*t+2] < 3)
+				continue;
+			for (uint32_t c=3*t; c<3*t+3; ++c)
+				indices.push_back( delaunay.corners[c] );
+		}
+		pPlotArea->triangles( delaunay.vertices, heights, zmin, zmax, indices,
+				color_map.lookup_table() );
 	}
 
 	void BackendHeightMap::calculate_height_scaling() {
@@ -1044,10 +1576,9 @@ namespace realtimeplot {
 		double v = 0;
 		double dz = zmax - zmin;
 		// calculate mean and sd
-		size_t dim = delaunay.vertices.size();
-		for (size_t i=0; i<delaunay.vertices.size(); ++i) {
-			double fraction = (boost::static_pointer_cast<Vertex3D, delaunay::Vertex>( 
-						delaunay.vertices[i] )->z-zmin)/dz;
+		size_t dim = heights.size()-3;
+		for (size_t i=3; i<heights.size(); ++i) {
+			double fraction = (heights[i]-zmin)/dz;
 			if (fraction >= 0 && fraction <= 1) {
 				mean += fraction; 
 				v += pow(fraction, 2);
@@ -1063,5 +1594,120 @@ namespace realtimeplot {
 		if (delaunay.vertices.size()>=3)
 			plot();
 	}
-}
 
+	/*
+	 * GridHeightMap
+	 */
+	BackendGridHeightMap::BackendGridHeightMap( PlotConfig cfg, 
+			boost::shared_ptr<EventHandler> pEventHandler,
+			size_t nx, size_t ny ) : 
+		BackendPlot( cfg, pEventHandler ),
+		no_x( std::max<size_t>( 2, nx ) ), no_y( std::max<size_t>( 2, ny ) ),
+		zs( no_x*no_y, 0 ),
+		zmin( 0 ), zmax( 0 ), 
+		width_x( (config.max_x-config.min_x)/(no_x-1) ),
+		width_y( (config.max_y-config.min_y)/(no_y-1) ),
+		has_data( false ), needs_full_redraw( false )
+	{
+		clear_dirty();
+	}
+
+	void BackendGridHeightMap::add_data( float x, float y, float z, bool show ) {
+		// Snap to the closest node
+		double u = round( (x-config.min_x)/width_x );
+		double v = round( (y-config.min_y)/width_y );
+		if (u < 0 || v < 0 || u >= no_x || v >= no_y)
+			return;
+		size_t i = u;
+		size_t j = v;
+		zs[i*no_y+j] = z;
+
+		bool redraw_all = false;
+		if (!has_data) {
+			zmin = z;
+			zmax = z;
+			has_data = true;
+			redraw_all = true;
+		} else if (z<zmin) {
+			zmin = z;
+			redraw_all = true;
+		} else if (z>zmax) {
+			zmax = z;
+			redraw_all = true;
+		}
+		if (redraw_all)
+			needs_full_redraw = true;
+		// Cells around the node, kept until the next shown update
+		dirty_first_x = std::min( dirty_first_x, (i>0) ? i-1 : 0 );
+		dirty_last_x = std::max( dirty_last_x, std::min( i+1, no_x-1 ) );
+		dirty_first_y = std::min( dirty_first_y, (j>0) ? j-1 : 0 );
+		dirty_last_y = std::max( dirty_last_y, std::min( j+1, no_y-1 ) );
+		if (!show)
+			return;
+		if (needs_full_redraw)
+			plot();
+		else {
+			draw_cells( dirty_first_x, dirty_last_x, dirty_first_y, dirty_last_y );
+			clear_dirty();
+			display();
+		}
+	}
+
+	void BackendGridHeightMap::set_data( const std::vector<float> &new_zs, bool show ) {
+		size_t n = std::min( new_zs.size(), zs.size() );
+		std::copy( new_zs.begin(), new_zs.begin()+n, zs.begin() );
+		if (n > 0) {
+			zmin = *std::min_element( zs.begin(), zs.end() );
+			zmax = *std::max_element( zs.begin(), zs.end() );
+			has_data = true;
+		}
+		if (show)
+			plot();
+		else
+			needs_full_redraw = true;
+	}
+
+	void BackendGridHeightMap::plot() {
+		bool before = pause_display;
+		pause_display = true; // Don't draw while updating the screen
+		clear();
+		draw_cells( 0, no_x-1, 0, no_y-1 );
+		needs_full_redraw = false;
+		clear_dirty();
+		pause_display = before;
+		display();
+	}
+
+	void BackendGridHeightMap::clear_dirty() {
+		dirty_first_x = no_x;
+		dirty_last_x = 0;
+		dirty_first_y = no_y;
+		dirty_last_y = 0;
+	}
+
+	void BackendGridHeightMap::draw_cells( size_t first_x, size_t last_x,
+			size_t first_y, size_t last_y ) {
+		pPlotArea->bilinear( zs, no_x, no_y, config.min_x, config.min_y,
+				width_x, width_y, zmin, zmax, color_map.lookup_table(),
+				first_x, last_x, first_y, last_y );
+	}
+
+	void BackendGridHeightMap::calculate_height_scaling() {
+		double mean = 0;
+		double v = 0;
+		double dz = zmax - zmin;
+		if (dz <= 0)
+			return;
+		for (auto & z : zs) {
+			double fraction = (z-zmin)/dz;
+			mean += fraction; 
+			v += pow(fraction, 2);
+		}
+		mean /= zs.size();
+		v = v/zs.size()-pow(mean,2);
+
+		color_map.calculate_height_scaling( mean, v );
+
+		plot();
+	}
+}
@@ -22,12 +22,18 @@
 	 */
 
 #include "math.h"
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <boost/multiprecision/cpp_int.hpp>
+#include <boost/thread.hpp>
 
 #include "realtimeplot/delaunay.h"
 #include "ostream"
 namespace realtimeplot {
 	namespace delaunay {
-		bool Edge::intersect(  Edge& e ) {
+		bool Edge::intersect( const Edge& e ) const {
 			Vertex v = intersectionVertex( e );
 
 			if (e.include( v ) && include( v ))
@@ -37,12 +43,12 @@ namespace realtimeplot {
 
 		}
 
-		bool Edge::include( Vertex &v ) {
+		bool Edge::include( const Vertex &v ) const {
 			//is the vertex on the edge. Edge does not include it's two end points
-			float x1 = pV0->x;
-			float x2 = pV1->x;
-			float y1 = pV0->y;
-			float y2 = pV1->y;
+			float x1 = v0.x;
+			float x2 = v1.x;
+			float y1 = v0.y;
+			float y2 = v1.y;
 
 			float x5 = v.x;
 			float y5 = v.y;
@@ -57,16 +63,16 @@ namespace realtimeplot {
 			return true;
 		}
 
-		Vertex Edge::intersectionVertex( Edge& e ) {
+		Vertex Edge::intersectionVertex( const Edge& e ) const {
 			//Calculate intersection point
-			float x1 = pV0->x;
-			float x2 = pV1->x;
-			float y1 = pV0->y;
-			float y2 = pV1->y;
-			float x3 = e.pV0->x;
-			float x4 = e.pV1->x;
-			float y3 = e.pV0->y;
-			float y4 = e.pV1->y;
+			float x1 = v0.x;
+			float x2 = v1.x;
+			float y1 = v0.y;
+			float y2 = v1.y;
+			float x3 = e.v0.x;
+			float x4 = e.v1.x;
+			float y3 = e.v0.y;
+			float y4 = e.v1.y;
 
 			//Intersection point (see wikipedia line-line intersection)
 			float x5 = ((x1*y2-y1*x2)*(x3-x4)-(x1-x2)*(x3*y4-y3*x4))/
@@ -77,75 +83,168 @@ namespace realtimeplot {
 		}
 
 
-		bool Triangle::inTriangle( boost::shared_ptr<Vertex> pV ) {
-			// Compute vectors        
-			Vertex v0 = (*corners[2]->vertex.get())-(*corners[0]->vertex.get());
-			Vertex v1 = (*corners[1]->vertex.get())-(*corners[0]->vertex.get());
-			Vertex v2 = (*pV.get())-(*corners[0]->vertex.get());
-			// Compute dot products
-			float dot00 = v0.dot( v0 );
-			float dot01 = v0.dot( v1 );
-			float dot02 = v0.dot( v2 );
-			float dot11 = v1.dot( v1 );
-			float dot12 = v1.dot( v2 );
-
-			// Compute barycentric coordinates
-			float invDenom = 1.0 / (dot00 * dot11 - dot01 * dot01);
-			float u = (dot11 * dot02 - dot01 * dot12) * invDenom;
-			float v = (dot00 * dot12 - dot01 * dot02) * invDenom;
-
-			// Check if point is in triangle
-			return (u >= 0) && (v >= 0) && (u + v <= 1);
+		/*
+		 * Predicates
+		 *
+		 * Floating point filter with the error bounds from Shewchuk, Adaptive 
+		 * Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates.
+		 * Coordinates are floats, so they convert exactly to the rationals used
+		 * in the (rarely needed) exact fallback.
+		 */
+		typedef boost::multiprecision::cpp_rational exact_t;
+
+		static const double epsilon = std::numeric_limits<double>::epsilon()/2;
+		static const double ccwerrboundA = (3.0 + 16.0*epsilon)*epsilon;
+		static const double iccerrboundA = (10.0 + 96.0*epsilon)*epsilon;
+
+		double orient2d( const Vertex &a, const Vertex &b, const Vertex &c ) {
+			double detleft = (double(a.x)-c.x)*(double(b.y)-c.y);
+			double detright = (double(a.y)-c.y)*(double(b.x)-c.x);
+			double det = detleft - detright;
+			double errbound = ccwerrboundA*(fabs( detleft ) + fabs( detright ));
+			if (det > errbound || -det > errbound)
+				return det;
+
+			exact_t acx = exact_t( a.x ) - exact_t( c.x );
+			exact_t acy = exact_t( a.y ) - exact_t( c.y );
+			exact_t bcx = exact_t( b.x ) - exact_t( c.x );
+			exact_t bcy = exact_t( b.y ) - exact_t( c.y );
+			return sign( acx*bcy - acy*bcx );
 		}
 
-		bool Triangle::inCircumCircle( boost::shared_ptr<Vertex> pV ) {
-			// For now recalculate everything everytime, since vertices of corners
-			// can change between calls
-			float x0 = corners[0]->vertex->x;
-			float y0 = corners[0]->vertex->y;
+		double incircle( const Vertex &a, const Vertex &b, const Vertex &c,
+				const Vertex &d ) {
+			double adx = double(a.x)-d.x;
+			double ady = double(a.y)-d.y;
+			double bdx = double(b.x)-d.x;
+			double bdy = double(b.y)-d.y;
+			double cdx = double(c.x)-d.x;
+			double cdy = double(c.y)-d.y;
 
-			float x1 = corners[1]->vertex->x;
-			float y1 = corners[1]->vertex->y;
+			double bdxcdy = bdx*cdy;
+			double cdxbdy = cdx*bdy;
+			double alift = adx*adx + ady*ady;
 
-			float x2 = corners[2]->vertex->x;
-			float y2 = corners[2]->vertex->y;
-			
-			//Calculate vectors for 2 of the edges
-			Vertex v1 = Vertex( x1-x0, y1-y0 );
-			Vertex v2 = Vertex( x2-x0, y2-y0 );
+			double cdxady = cdx*ady;
+			double adxcdy = adx*cdy;
+			double blift = bdx*bdx + bdy*bdy;
 
-			//Check if they are parallel (x0/x1 == y0/y1), i.e if (x0*y1==x1*y0)
-			//-> Triangle is basically one line and thus circumcircle is infinite 
-			//-> return true;
-			if ((v1.x==0 && v1.y ==0) || (v2.x == 0 && v2.y==0)) 
-				return false; //Vector length of zero, so point won't be in here
-			if (v1.x*v2.y == v2.x*v1.y)
-				return true;
+			double adxbdy = adx*bdy;
+			double bdxady = bdx*ady;
+			double clift = cdx*cdx + cdy*cdy;
 
-			//Find intersection point.
-			Vertex inter = centerGivenTwoEdges( v1, v2 );
-			
-			//Radius is distance from intersection point to any corner
-			float m_R2 = pow((inter.x-x0),2)+pow(inter.y-y0,2);
-			
-			//Calculate distance from intersection to the given vertex
-			float dist2 = pow((inter.x-pV->x),2)+pow(inter.y-pV->y,2);
-			
-			//Compare those two
-			return dist2 < m_R2;
+			double det = alift*(bdxcdy - cdxbdy) + blift*(cdxady - adxcdy) 
+				+ clift*(adxbdy - bdxady);
+			double permanent = (fabs( bdxcdy ) + fabs( cdxbdy ))*alift
+				+ (fabs( cdxady ) + fabs( adxcdy ))*blift
+				+ (fabs( adxbdy ) + fabs( bdxady ))*clift;
+			double errbound = iccerrboundA*permanent;
+			if (det > errbound || -det > errbound)
+				return det;
+
+			exact_t eadx = exact_t( a.x ) - exact_t( d.x );
+			exact_t eady = exact_t( a.y ) - exact_t( d.y );
+			exact_t ebdx = exact_t( b.x ) - exact_t( d.x );
+			exact_t ebdy = exact_t( b.y ) - exact_t( d.y );
+			exact_t ecdx = exact_t( c.x ) - exact_t( d.x );
+			exact_t ecdy = exact_t( c.y ) - exact_t( d.y );
+			return sign( (eadx*eadx + eady*eady)*(ebdx*ecdy - ecdx*ebdy)
+					+ (ebdx*ebdx + ebdy*ebdy)*(ecdx*eady - eadx*ecdy)
+					+ (ecdx*ecdx + ecdy*ecdy)*(eadx*ebdy - ebdx*eady) );
+		}
+
+		uint64_t hilbertIndex( uint32_t x, uint32_t y ) {
+			const uint32_t n = 1 << 16;
+			uint64_t d = 0;
+			for (uint32_t s=n/2; s>0; s/=2) {
+				uint32_t rx = (x & s) > 0;
+				uint32_t ry = (y & s) > 0;
+				d += uint64_t(s)*s*((3*rx)^ry);
+				// Rotate the quadrant
+				if (ry == 0) {
+					if (rx == 1) {
+						x = n-1-x;
+						y = n-1-y;
+					}
+					std::swap( x, y );
+				}
+			}
+			return d;
+		}
+
+		std::vector<uint32_t> insertionOrder( const std::vector<Vertex> &vertices ) {
+			size_t n = vertices.size();
+			std::vector<uint32_t> order( n );
+			if (n == 0)
+				return order;
+			for (size_t i=0; i<n; ++i)
+				order[i] = i;
+			// Fixed seed, so that the result is reproducible
+			std::mt19937 generator( 1 );
+			std::shuffle( order.begin(), order.end(), generator );
+
+			float min_x = vertices[0].x, max_x = vertices[0].x;
+			float min_y = vertices[0].y, max_y = vertices[0].y;
+			for (auto & v : vertices) {
+				min_x = std::min( min_x, v.x );
+				max_x = std::max( max_x, v.x );
+				min_y = std::min( min_y, v.y );
+				max_y = std::max( max_y, v.y );
+			}
+			double scale_x = (max_x > min_x) ? 65535.0/(double(max_x)-min_x) : 0;
+			double scale_y = (max_y > min_y) ? 65535.0/(double(max_y)-min_y) : 0;
+			std::vector<uint64_t> keys( n );
+			for (size_t i=0; i<n; ++i)
+				keys[i] = hilbertIndex( (vertices[i].x-min_x)*scale_x, 
+						(vertices[i].y-min_y)*scale_y );
+
+			// Rounds [n/2,n), [n/4,n/2), ..., smallest rounds are merged
+			size_t end = n;
+			while (end > 0) {
+				size_t begin = (end > 64) ? end/2 : 0;
+				std::sort( order.begin()+begin, order.begin()+end,
+						[&keys]( uint32_t a, uint32_t b ) { return keys[a] < keys[b]; } );
+				end = begin;
+			}
+			return order;
 		}
 
-		Vertex Triangle::center() {
-			// For now recalculate everything everytime, since vertices of corners
-			// can change between calls
-			float x0 = corners[0]->vertex->x;
-			float y0 = corners[0]->vertex->y;
+		bool Triangle::inTriangle( const Vertex &v ) const {
+			double o = orient2d( vertices[0], vertices[1], vertices[2] );
+			double o0 = orient2d( vertices[0], vertices[1], v );
+			double o1 = orient2d( vertices[1], vertices[2], v );
+			double o2 = orient2d( vertices[2], vertices[0], v );
+			// Works for either orientation of the triangle
+			if (o < 0)
+				return o0 <= 0 && o1 <= 0 && o2 <= 0;
+			return o0 >= 0 && o1 >= 0 && o2 >= 0;
+		}
 
-			float x1 = corners[1]->vertex->x;
-			float y1 = corners[1]->vertex->y;
+		bool Triangle::inCircumCircle( const Vertex &v ) const {
+			double o = orient2d( vertices[0], vertices[1], vertices[2] );
+			if (o == 0) {
+				// Triangle is basically one line and thus circumcircle is infinite,
+				// unless two of the corners coincide
+				if (vertices[0] == vertices[1] || vertices[1] == vertices[2] 
+						|| vertices[2] == vertices[0])
+					return false;
+				return true;
+			}
+			double ic = incircle( vertices[0], vertices[1], vertices[2], v );
+			if (o < 0)
+				return ic < 0;
+			return ic > 0;
+		}
 
-			float x2 = corners[2]->vertex->x;
-			float y2 = corners[2]->vertex->y;
+		Vertex Triangle::center() const {
+			float x0 = vertices[0].x;
+			float y0 = vertices[0].y;
+
+			float x1 = vertices[1].x;
+			float y1 = vertices[1].y;
+
+			float x2 = vertices[2].x;
+			float y2 = vertices[2].y;
 			
 			//Calculate vectors for 2 of the edges
 			Vertex v1 = Vertex( x1-x0, y1-y0 );
@@ -155,44 +254,33 @@ namespace realtimeplot {
 		}
 
 
-		Vertex Triangle::centerGivenTwoEdges( Vertex &v1, Vertex &v2 ) {
-			float x0 = corners[0]->vertex->x;
-			float y0 = corners[0]->vertex->y;
+		Vertex Triangle::centerGivenTwoEdges( const Vertex &v1, const Vertex &v2 ) const {
+			float x0 = vertices[0].x;
+			float y0 = vertices[0].y;
 
 			Vertex perp_v1 = Vertex( -v1.y, v1.x );
 			Vertex perp_v2 = Vertex( -v2.y, v2.x );
 
-			Edge e1 = Edge( boost::shared_ptr<Vertex>( new Vertex( 0.5*v1.x+x0, 0.5*v1.y+y0 ) ),
-					boost::shared_ptr<Vertex>( 
-						new Vertex( 0.5*v1.x+x0+perp_v1.x, 0.5*v1.y+y0+perp_v1.y ) ) );
-			Edge e2 = Edge( boost::shared_ptr<Vertex>( new Vertex( 0.5*v2.x+x0, 0.5*v2.y+y0 ) ),
-					boost::shared_ptr<Vertex>( 
-						new Vertex( 0.5*v2.x+x0+perp_v2.x, 0.5*v2.y+y0+perp_v2.y ) ) );
+			Edge e1 = Edge( Vertex( 0.5*v1.x+x0, 0.5*v1.y+y0 ),
+					Vertex( 0.5*v1.x+x0+perp_v1.x, 0.5*v1.y+y0+perp_v1.y ) );
+			Edge e2 = Edge( Vertex( 0.5*v2.x+x0, 0.5*v2.y+y0 ),
+					Vertex( 0.5*v2.x+x0+perp_v2.x, 0.5*v2.y+y0+perp_v2.y ) );
 			//Find intersection point.
 			return e1.intersectionVertex( e2 );
 		}
 	
 
 		Delaunay::Delaunay( float min_x, float max_x, float min_y, float max_y )
+			: seeds( noSeedCells*noSeedCells, noCorner ),
+			seed_min_x( min_x ), seed_min_y( min_y ), 
+			seed_width_x( (max_x-min_x)/noSeedCells ),
+			seed_width_y( (max_y-min_y)/noSeedCells ),
+			lastTriangle( 0 )
 		{
 			setSuperTriangle( min_x, max_x, min_y, max_y );
-			for (size_t i = 0; i<3; ++i) {
-				boost::shared_ptr<Corner> corner (new Corner());
-				corner->vertex = vertices[i];
-				corner->triangle = triangles[0];
-				corners.push_back( corner );
-				triangles[0]->corners.push_back( corner );
-			}
-
-			for (size_t i = 0; i<3; ++i) {
-				int j = i+1;
-				if (j>=3)
-					j = j%3;
-				corners[i]->next = corners[j];
-				j = i-1;
-				if (j<0)
-					j = 3+j;
-				corners[i]->previous = corners[j];
+			for (uint32_t i = 0; i<3; ++i) {
+				corners.push_back( i );
+				opposites.push_back( noCorner );
 			}
 		}
 
@@ -210,215 +298,813 @@ namespace realtimeplot {
 			double x2 = 1.0/6*(3*dy+sq3*dy);
 			double a1 = 1.0/6*(3-sq3);
 
-			vertices.push_back( boost::shared_ptr<Vertex>( new Vertex( min_x + b1*dx, 
-							min_y + 1.2*dy + x1) ) );
-			vertices.push_back( boost::shared_ptr<Vertex>( new Vertex( min_x - 1.2*x2, 
-							min_y + a1*dy ) ) );
-			vertices.push_back( boost::shared_ptr<Vertex>( new Vertex( min_x+b1*dx+l2, 
-							min_y+dy+x1-l1 ) ) );
-		
-			triangles.push_back( boost::shared_ptr<Triangle>( new Triangle ) );
+			vertices.push_back( Vertex( min_x + b1*dx, min_y + 1.2*dy + x1) );
+			vertices.push_back( Vertex( min_x - 1.2*x2, min_y + a1*dy ) );
+			vertices.push_back( Vertex( min_x+b1*dx+l2, min_y+dy+x1-l1 ) );
+		}
+
+		uint32_t Delaunay::add_data( const Vertex &vertex ) {
+			uint32_t triangle = findTriangle( vertex );
+			for (uint32_t c=3*triangle; c<3*triangle+3; ++c) {
+				if (this->vertex( c ) == vertex)
+					return corners[c];
+			}
+			uint32_t v = createNewTriangles( vertex, triangle );
+			lastTriangle = triangle;
+			if (!seeds.empty())
+				seeds[seedCell( vertex )] = triangle;
+			return v;
 		}
 
-		void Delaunay::add_data( boost::shared_ptr<Vertex> vertex ) {
-			boost::shared_ptr<Triangle> triangle =
-				findTriangle( vertex, triangles[0]  );
-			createNewTriangles( vertex, triangle );
+		std::vector<uint32_t> Delaunay::add_data( const std::vector<Vertex> &batch ) {
+			vertices.reserve( vertices.size() + batch.size() );
+			corners.reserve( corners.size() + 6*batch.size() );
+			opposites.reserve( opposites.size() + 6*batch.size() );
+
+			std::vector<uint32_t> ids( batch.size() );
+			std::vector<uint32_t> order = insertionOrder( batch );
+			for (auto & i : order)
+				ids[i] = add_data( batch[i] );
+			return ids;
 		}
 
-		boost::shared_ptr<Triangle> 
-			Delaunay::findTriangle( boost::shared_ptr<Vertex> vertex, boost::shared_ptr<Triangle> tr ) 
-		{
+		/*
+		 * Divide and conquer triangulation (Guibas and Stolfi, 1985), used by 
+		 * Delaunay::triangulate. The triangulation is build in a quad edge
+		 * structure, which makes merging two triangulations straightforward, and 
+		 * converted to the corner table afterwards.
+		 */
+		namespace {
+			/**
+			 * \brief Directed edge, index of its quad times four plus its rotation
+			 *
+			 * The four rotations are the edge, its dual and their reverses.
+			 */
+			typedef uint32_t QuadEdge;
 
-			//Vertex in that triangle
-			//Using the exact barycenter is more likely to produce numerical errors,
-			//so using a slightly different point in the triangle
-			Vertex start_v = tr->corners[0]->vertex->scalar( 2.3/6.0 ) + 
-				tr->corners[1]->vertex->scalar( 1.9/6.0 ) +
-				tr->corners[2]->vertex->scalar( 1.8/6.0 );
-			boost::shared_ptr<Vertex> pStart_v( new Vertex( start_v.x, start_v.y ) );
-
-			//Find edge that a line between that vertex and the provided vertex passes through
-			//(if none found, then return current triangle)
-			size_t i = 0;
-			bool passed = false;
-			boost::shared_ptr<Corner> current_corner;
-			Edge eline = Edge( pStart_v, vertex );
-			while (i<3 && !passed) {
-				Edge etriangle = Edge( tr->corners[i]->vertex, tr->corners[i]->next->vertex );
-				if (etriangle.intersect( eline )) {
-					passed = true;
-					current_corner = tr->corners[i];
-				}
-				++i;
+			struct Quad {
+				//! Next edge counterclockwise around the origin, per rotation
+				QuadEdge next[4];
+				//! Vertex (or, for the dual edges, face) each rotation starts from
+				uint32_t org[4];
+			};
+
+			//! Face marker of the area outside of the convex hull
+			const uint32_t outerFace = noCorner-1;
+
+			QuadEdge rot( QuadEdge e ) {
+				return (e & ~3u) | ((e+1) & 3u);
 			}
 
-			if (!passed) {
-				//std::cout << "Blaat 1" << std::endl;
-				//The point is in the current triangle
-				return tr;
+			QuadEdge sym( QuadEdge e ) {
+				return e ^ 2u;
 			}
-			current_corner = current_corner->previous->opposite;
-			tr = current_corner->triangle;
-
-			while (passed) {
-				Edge etriangle = Edge( current_corner->vertex, current_corner->next->vertex );
-
-				//Check if it passes the vertex to the right,
-				//Check to the left
-				//Check if it goes through the current corner
-				//If none then we are in the current triangle
-
-				if (etriangle.intersect( eline )) {
-					current_corner = current_corner->previous->opposite;
-					tr = current_corner->triangle;
-				} else {
-					etriangle = Edge( current_corner->vertex, 
-							current_corner->previous->vertex );
-					//Is it to the left?
-					if (etriangle.intersect( eline )) {
-						current_corner = current_corner->next->opposite;
-						tr = current_corner->triangle;
-					} else {
-						// Is current vertex on the line
-						if (eline.include( (*current_corner->vertex) ) ) {
-							if (float(rand())/RAND_MAX < 0.5 && current_corner->previous->opposite ) {
-								tr = findTriangle( vertex, current_corner->previous->opposite->triangle );
-								passed = false;
-							} else {
-								tr = findTriangle( vertex, current_corner->next->opposite->triangle );
-								passed = false;
+
+			QuadEdge rotInv( QuadEdge e ) {
+				return (e & ~3u) | ((e+3) & 3u);
+			}
+
+			/**
+			 * \brief Quads of all threads, allocated in chunks
+			 *
+			 * Chunks never move, so a thread can allocate a chunk while others keep 
+			 * using theirs. Unused quads have next[0] set to noCorner.
+			 */
+			class QuadStore {
+				public:
+					static const uint32_t chunkBits = 16;
+					static const uint32_t chunkSize = 1 << chunkBits;
+
+					QuadStore() : chunks( 1 << (30-chunkBits) ), noChunks( 0 ) {}
+
+					Quad &quad( QuadEdge e ) {
+						return chunks[e >> (chunkBits+2)][(e >> 2) & (chunkSize-1)];
+					}
+
+					QuadEdge &next( QuadEdge e ) {
+						return quad( e ).next[e & 3u];
+					}
+
+					uint32_t &org( QuadEdge e ) {
+						return quad( e ).org[e & 3u];
+					}
+
+					uint32_t dest( QuadEdge e ) {
+						return org( sym( e ) );
+					}
+
+					//! Left face of an edge is stored as the origin of its dual
+					uint32_t &leftFace( QuadEdge e ) {
+						return org( rotInv( e ) );
+					}
+
+					QuadEdge oprev( QuadEdge e ) {
+						return rot( next( rot( e ) ) );
+					}
+
+					QuadEdge lnext( QuadEdge e ) {
+						return rot( next( rotInv( e ) ) );
+					}
+
+					QuadEdge rprev( QuadEdge e ) {
+						return next( sym( e ) );
+					}
+
+					void splice( QuadEdge a, QuadEdge b ) {
+						QuadEdge alpha = rot( next( a ) );
+						QuadEdge beta = rot( next( b ) );
+						std::swap( next( a ), next( b ) );
+						std::swap( next( alpha ), next( beta ) );
+					}
+
+					//! Allocate a chunk, returns the index of its first quad
+					uint32_t newChunk() {
+						boost::mutex::scoped_lock lock( mutex );
+						if (noChunks == chunks.size())
+							throw std::length_error( "Too many edges to triangulate" );
+						Quad unused;
+						unused.next[0] = noCorner;
+						chunks[noChunks].resize( chunkSize, unused );
+						return (noChunks++) << chunkBits;
+					}
+
+					std::vector<std::vector<Quad> > chunks;
+					size_t noChunks;
+				private:
+					boost::mutex mutex;
+			};
+
+			//! Creates and deletes edges, one pool per thread
+			class EdgePool {
+				public:
+					EdgePool( QuadStore &store ) : store( &store ), 
+						next_quad( 0 ), end_quad( 0 )
+					{}
+
+					QuadEdge makeEdge( uint32_t a, uint32_t b ) {
+						uint32_t q;
+						if (!unused.empty()) {
+							q = unused.back();
+							unused.pop_back();
+						} else {
+							if (next_quad == end_quad) {
+								next_quad = store->newChunk();
+								end_quad = next_quad + QuadStore::chunkSize;
+							}
+							q = next_quad++;
+						}
+						QuadEdge e = q << 2;
+						Quad &quad = store->quad( e );
+						quad.next[0] = e; quad.org[0] = a;
+						quad.next[1] = e+3; quad.org[1] = noCorner;
+						quad.next[2] = e+2; quad.org[2] = b;
+						quad.next[3] = e+1; quad.org[3] = noCorner;
+						return e;
+					}
+
+					//! Connect dest(a) to org(b), so that a, the new edge and b share a left face
+					QuadEdge connect( QuadEdge a, QuadEdge b ) {
+						QuadEdge e = makeEdge( store->dest( a ), store->org( b ) );
+						store->splice( e, store->lnext( a ) );
+						store->splice( sym( e ), b );
+						return e;
+					}
+
+					//! Remove the edge, its quad can be reused by this pool
+					void deleteEdge( QuadEdge e ) {
+						store->splice( e, store->oprev( e ) );
+						store->splice( sym( e ), store->oprev( sym( e ) ) );
+						store->quad( e ).next[0] = noCorner;
+						unused.push_back( e >> 2 );
+					}
+
+				private:
+					QuadStore *store;
+					uint32_t next_quad, end_quad;
+					std::vector<uint32_t> unused;
+			};
+
+			//! Vertex together with its position in the input
+			struct SortVertex {
+				Vertex v;
+				uint32_t id;
+			};
+
+			bool lexicographic( const SortVertex &a, const SortVertex &b ) {
+				return a.v.x < b.v.x || (a.v.x == b.v.x && a.v.y < b.v.y);
+			}
+
+			/**
+			 * \brief Lexicographic order after rotating the plane over -90 degrees (axis 1)
+			 *
+			 * Rotating does not change any of the predicates, so the same merge works
+			 * for halves split by a vertical (axis 0) or horizontal (axis 1) line.
+			 */
+			struct AxisOrder {
+				int axis;
+				AxisOrder( int axis ) : axis( axis ) {}
+				bool operator()( const SortVertex &a, const SortVertex &b ) const {
+					if (axis == 0)
+						return lexicographic( a, b );
+					return a.v.y < b.v.y || (a.v.y == b.v.y && a.v.x > b.v.x);
+				}
+			};
+
+			//! Sort both halves in parallel and merge them
+			void parallelSort( std::vector<SortVertex>::iterator first, 
+					std::vector<SortVertex>::iterator last, size_t no_threads ) {
+				if (no_threads < 2 || last-first < 65536) {
+					std::sort( first, last, lexicographic );
+					return;
+				}
+				std::vector<SortVertex>::iterator middle = first + (last-first)/2;
+				boost::thread left( &parallelSort, first, middle, no_threads/2 );
+				parallelSort( middle, last, no_threads-no_threads/2 );
+				left.join();
+				std::inplace_merge( first, middle, last, lexicographic );
+			}
+
+			/**
+			 * \brief Guibas and Stolfi with alternating cuts (Dwyer)
+			 *
+			 * Splitting alternately by x and y keeps the triangles of the sub 
+			 * triangulations well shaped, so far fewer edges are deleted again when 
+			 * merging than with vertical cuts only.
+			 */
+			class DivideAndConquer {
+				public:
+					typedef std::pair<QuadEdge, QuadEdge> Hull;
+
+					//! Points should be unique, they are reordered while splitting
+					DivideAndConquer( std::vector<SortVertex> &points, size_t no_threads )
+						: pools( no_threads, EdgePool( store ) ), points( points )
+					{}
+
+					/**
+					 * \brief Triangulate points lo till hi, using pools pool till pool+no_threads 
+					 *
+					 * Returns the counterclockwise convex hull edge out of the first vertex
+					 * and the clockwise one out of the last vertex, in the order of axis.
+					 */
+					Hull triangulate( uint32_t lo, uint32_t hi, int axis, size_t pool, 
+							size_t no_threads ) {
+						EdgePool &edges = pools[pool];
+						uint32_t n = hi-lo;
+						if (n <= 3) {
+							std::sort( points.begin()+lo, points.begin()+hi, AxisOrder( axis ) );
+							QuadEdge a = edges.makeEdge( lo, lo+1 );
+							if (n == 2)
+								return Hull( a, sym( a ) );
+							QuadEdge b = edges.makeEdge( lo+1, lo+2 );
+							store.splice( sym( a ), b );
+							if (ccw( lo, lo+1, lo+2 )) {
+								edges.connect( b, a );
+								return Hull( a, sym( b ) );
+							} else if (ccw( lo, lo+2, lo+1 )) {
+								QuadEdge c = edges.connect( b, a );
+								return Hull( sym( c ), c );
 							}
+							// Collinear
+							return Hull( a, sym( b ) );
 						}
-						else {
-							passed = false;
+
+						uint32_t mid = lo + n/2;
+						std::nth_element( points.begin()+lo, points.begin()+mid, 
+								points.begin()+hi, AxisOrder( axis ) );
+						Hull left, right;
+						if (no_threads > 1 && n > parallelCutoff) {
+							size_t no_left = no_threads/2;
+							boost::thread left_thread( &DivideAndConquer::subdivide, this,
+									lo, mid, 1-axis, pool, no_left, &left );
+							pool += no_left;
+							right = triangulate( mid, hi, 1-axis, pool, no_threads-no_left );
+							left_thread.join();
+						} else {
+							left = triangulate( lo, mid, 1-axis, pool, 1 );
+							right = triangulate( mid, hi, 1-axis, pool, 1 );
+						}
+						return merge( extremes( left, axis ), extremes( right, axis ), 
+								pools[pool] );
+					}
+
+					QuadStore store;
+					std::vector<EdgePool> pools;
+
+				private:
+					//! Below this size the halves are not triangulated in separate threads
+					static const uint32_t parallelCutoff = 4096;
+
+					void subdivide( uint32_t lo, uint32_t hi, int axis, size_t pool, 
+							size_t no_threads, Hull *result ) {
+						*result = triangulate( lo, hi, axis, pool, no_threads );
+					}
+
+					bool ccw( uint32_t a, uint32_t b, uint32_t c ) const {
+						return orient2d( points[a].v, points[b].v, points[c].v ) > 0;
+					}
+
+					//! Vertex d lies inside the circle through (counterclockwise) a, b and c
+					bool inCircle( uint32_t a, uint32_t b, uint32_t c, uint32_t d ) const {
+						// Happens when a candidate has no next edge, saves an exact evaluation
+						if (d == a || d == b || d == c)
+							return false;
+						return incircle( points[a].v, points[b].v, points[c].v, 
+								points[d].v ) > 0;
+					}
+
+					//! Candidate edge e lies above the base edge
+					bool valid( QuadEdge e, QuadEdge basel ) {
+						return ccw( store.dest( e ), store.dest( basel ), store.org( basel ) );
+					}
+
+					/**
+					 * \brief Hull edges out of the first and last vertex in the order of axis
+					 *
+					 * Walks the outer face, which is short compared to the triangulation
+					 */
+					Hull extremes( Hull hull, int axis ) {
+						AxisOrder before( axis );
+						QuadEdge start = sym( hull.first );
+						QuadEdge first = noCorner, first_prev = noCorner, last = noCorner;
+						QuadEdge prev = start;
+						QuadEdge e = store.lnext( start );
+						do {
+							uint32_t v = store.org( e );
+							if (first == noCorner || before( points[v], points[store.org( first )] )) {
+								first = e;
+								first_prev = prev;
+							}
+							if (last == noCorner || before( points[store.org( last )], points[v] ))
+								last = e;
+							prev = e;
+							e = store.lnext( e );
+						} while (prev != start);
+						return Hull( sym( first_prev ), last );
+					}
+
+					/**
+					 * \brief Stitch the left and right triangulation together
+					 *
+					 * Starts with the lower common tangent and works its way up, deleting 
+					 * the edges that are no longer Delaunay.
+					 */
+					Hull merge( Hull left, Hull right, EdgePool &edges ) {
+						QuadEdge ldo = left.first, ldi = left.second;
+						QuadEdge rdi = right.first, rdo = right.second;
+						// Lower common tangent
+						for (;;) {
+							if (ccw( store.org( rdi ), store.org( ldi ), store.dest( ldi ) ))
+								ldi = store.lnext( ldi );
+							else if (ccw( store.org( ldi ), store.dest( rdi ), store.org( rdi ) ))
+								rdi = store.rprev( rdi );
+							else
+								break;
+						}
+
+						QuadEdge basel = edges.connect( sym( rdi ), ldi );
+						if (store.org( ldi ) == store.org( ldo ))
+							ldo = sym( basel );
+						if (store.org( rdi ) == store.org( rdo ))
+							rdo = basel;
+
+						for (;;) {
+							uint32_t b0 = store.org( basel ), b1 = store.dest( basel );
+							QuadEdge lcand = store.next( sym( basel ) );
+							if (valid( lcand, basel )) {
+								while (inCircle( b1, b0, store.dest( lcand ), 
+											store.dest( store.next( lcand ) ) )) {
+									QuadEdge t = store.next( lcand );
+									edges.deleteEdge( lcand );
+									lcand = t;
+								}
+							}
+							QuadEdge rcand = store.oprev( basel );
+							if (valid( rcand, basel )) {
+								while (inCircle( b1, b0, store.dest( rcand ), 
+											store.dest( store.oprev( rcand ) ) )) {
+									QuadEdge t = store.oprev( rcand );
+									edges.deleteEdge( rcand );
+									rcand = t;
+								}
+							}
+							bool lvalid = valid( lcand, basel );
+							bool rvalid = valid( rcand, basel );
+							if (!lvalid && !rvalid)
+								break;
+							if (!lvalid || (rvalid && inCircle( store.dest( lcand ), 
+											store.org( lcand ), store.org( rcand ), store.dest( rcand ) )))
+								basel = edges.connect( rcand, sym( basel ) );
+							else
+								basel = edges.connect( sym( basel ), sym( lcand ) );
 						}
+						return Hull( ldo, rdo );
+					}
+
+					std::vector<SortVertex> &points;
+			};
+		};
+
+		std::vector<uint32_t> Delaunay::triangulate( const std::vector<Vertex> &points,
+				size_t no_threads ) {
+			if (no_threads == 0)
+				no_threads = std::max<unsigned int>( 1, 
+						boost::thread::hardware_concurrency() );
+
+			// Sort all vertices (including the super triangle) and drop duplicates
+			std::vector<SortVertex> sorted( points.size()+3 );
+			for (uint32_t i=0; i<3; ++i) {
+				sorted[i].v = vertices[i];
+				sorted[i].id = points.size()+i;
+			}
+			for (uint32_t i=0; i<points.size(); ++i) {
+				sorted[i+3].v = points[i];
+				sorted[i+3].id = i;
+			}
+			parallelSort( sorted.begin(), sorted.end(), no_threads );
+
+			// Drop duplicates, remembering where each input vertex ended up
+			std::vector<SortVertex> distinct;
+			distinct.reserve( sorted.size() );
+			std::vector<uint32_t> position( sorted.size() );
+			for (auto & s : sorted) {
+				if (distinct.empty() || !(distinct.back().v == s.v))
+					distinct.push_back( s );
+				position[s.id] = distinct.size()-1;
+			}
+			sorted.clear();
+			sorted.shrink_to_fit();
+
+			// Super triangle keeps its indices, the rest follows in sorted order.
+			// From here on the id of a distinct vertex is its index in vertices
+			std::vector<uint32_t> index( distinct.size(), noCorner );
+			for (uint32_t i=0; i<3; ++i)
+				index[position[points.size()+i]] = i;
+			vertices.resize( distinct.size() );
+			uint32_t v = 3;
+			for (uint32_t i=0; i<distinct.size(); ++i) {
+				if (index[i] == noCorner)
+					index[i] = v++;
+				vertices[index[i]] = distinct[i].v;
+				distinct[i].id = index[i];
+			}
+
+			DivideAndConquer dc( distinct, no_threads );
+			dc.triangulate( 0, distinct.size(), 0, 0, no_threads );
+
+			// Convert to corner table. Faces of the quad edge structure are stored 
+			// as the corner (3*t+i) that lies at the origin of each edge
+			corners.clear();
+			opposites.clear();
+			corners.reserve( 6*distinct.size() );
+			QuadStore &store = dc.store;
+			for (uint32_t q=0; q < (store.noChunks << QuadStore::chunkBits); ++q) {
+				if (store.quad( q << 2 ).next[0] == noCorner)
+					continue;
+				for (QuadEdge e = q << 2; e < (q << 2) + 4; e += 2) {
+					if (store.leftFace( e ) != noCorner)
+						continue;
+					QuadEdge e1 = store.lnext( e );
+					QuadEdge e2 = store.lnext( e1 );
+					if (store.lnext( e2 ) == e && orient2d( distinct[store.org( e )].v, 
+								distinct[store.org( e1 )].v, distinct[store.org( e2 )].v ) > 0) {
+						uint32_t c = corners.size();
+						store.leftFace( e ) = c;
+						store.leftFace( e1 ) = c+1;
+						store.leftFace( e2 ) = c+2;
+						corners.push_back( distinct[store.org( e )].id );
+						corners.push_back( distinct[store.org( e1 )].id );
+						corners.push_back( distinct[store.org( e2 )].id );
+					} else {
+						QuadEdge f = e;
+						do {
+							store.leftFace( f ) = outerFace;
+							f = store.lnext( f );
+						} while (f != e);
 					}
 				}
+			}
+			// The corner opposite to an edge is the one before the edge's origin
+			opposites.assign( corners.size(), noCorner );
+			for (uint32_t q=0; q < (store.noChunks << QuadStore::chunkBits); ++q) {
+				if (store.quad( q << 2 ).next[0] == noCorner)
+					continue;
+				uint32_t a = store.leftFace( q << 2 );
+				uint32_t b = store.leftFace( (q << 2) + 2 );
+				if (a != outerFace && b != outerFace)
+					setOpposites( previous( a ), previous( b ) );
+			}
 
+			freeVertices.clear();
+			freeTriangles.clear();
+			changedTriangles.clear();
+			lastTriangle = 0;
+			if (!seeds.empty()) {
+				std::fill( seeds.begin(), seeds.end(), noCorner );
+				for (uint32_t t=0; t<noTriangles(); ++t)
+					seeds[seedCell( vertex( 3*t ) )] = t;
 			}
-			//std::cout << "Blaat 10" << std::endl;
-			return tr;
+
+			std::vector<uint32_t> ids( points.size() );
+			for (uint32_t i=0; i<points.size(); ++i)
+				ids[i] = index[position[i]];
+			return ids;
 		}
 
-		void Delaunay::createNewTriangles( boost::shared_ptr<Vertex> vertex,
-			boost::shared_ptr<Triangle> triangle ) {
-			vertices.push_back( vertex );
-			boost::shared_ptr<Vertex> old_vertex = triangle->corners[0]->vertex;
-			triangle->corners[0]->vertex = vertex;
-
-			// Lot's of housekeeping. Most should be abstracted away by the Triangle/Corner
-			// classes, but isn't yet.
-			boost::shared_ptr<Triangle> tr1( new Triangle() );
-			boost::shared_ptr<Corner> c1( new Corner() );
-			c1->vertex = vertex;
-			c1->triangle = tr1;
-			tr1->corners.push_back( c1 );
-			boost::shared_ptr<Corner> c1n( new Corner() );
-			c1n->vertex = triangle->corners[0]->previous->vertex;
-			c1n->triangle = tr1;
-			tr1->corners.push_back( c1n );
-			c1->next = c1n;
-			c1n->previous = c1;
-			boost::shared_ptr<Corner> c1p( new Corner() );
-			c1p->vertex =  old_vertex;
-			c1p->triangle = tr1;
-			tr1->corners.push_back( c1p );
-			c1->previous = c1p;
-			c1p->next = c1;
-			c1n->next = c1p;
-			c1p->previous = c1n;
-
-			boost::shared_ptr<Triangle> tr2( new Triangle() );
-			boost::shared_ptr<Corner> c2( new Corner() );
-			c2->vertex = vertex;
-			c2->triangle = tr2;
-			tr2->corners.push_back( c2 );
-			boost::shared_ptr<Corner> c2n( new Corner() );
-			c2n->vertex = old_vertex;		
-			c2n->triangle = tr2;
-			tr2->corners.push_back( c2n );
-			c2->next = c2n;
-			c2n->previous = c2;
-			boost::shared_ptr<Corner> c2p( new Corner() );
-			c2p->vertex =  triangle->corners[0]->next->vertex; 
-			c2p->triangle = tr2;
-			tr2->corners.push_back( c2p );
-			c2->previous = c2p;
-			c2p->next = c2;
-			c2n->next = c2p;
-			c2p->previous = c2n;
-
-			triangles.push_back( tr1 );
-			triangles.push_back( tr2 );
-			corners.push_back( c1 );
-			corners.push_back( c1n );
-			corners.push_back( c1p );
-			corners.push_back( c2 );
-			corners.push_back( c2n );
-			corners.push_back( c2p );
+		uint32_t Delaunay::findTriangle( const Vertex &v ) const {
+			uint32_t tr = lastTriangle;
+			if (!seeds.empty() && seeds[seedCell( v )] != noCorner
+					&& !isDeleted( seeds[seedCell( v )] ))
+				tr = seeds[seedCell( v )];
+			return findTriangle( v, tr );
+		}
 
-			//Opposites
-			if (triangle->corners[0]->next->opposite) {
-				c1->opposite = triangle->corners[0]->next->opposite;
-				triangle->corners[0]->next->opposite->opposite = c1;
+		uint32_t Delaunay::findTriangle( const Vertex &v, uint32_t tr ) const
+		{
+			size_t step = 0;
+			bool moved = true;
+			while (moved) {
+				moved = false;
+				for (size_t i=0; i<3; ++i) {
+					uint32_t c = 3*tr + (i+step)%3;
+					// Edge opposite to corner c, triangles are counterclockwise
+					if (opposites[c] != noCorner && 
+							orient2d( vertex( next( c ) ), vertex( previous( c ) ), v ) < 0) {
+						tr = triangle( opposites[c] );
+						moved = true;
+						break;
+					}
+				}
+				++step;
 			}
-			if (triangle->corners[0]->previous->opposite) {
-				c2->opposite = triangle->corners[0]->previous->opposite;
-				triangle->corners[0]->previous->opposite->opposite = c2;
+			return tr;
+		}
+
+		size_t Delaunay::seedCell( const Vertex &v ) const {
+			float fx = (v.x-seed_min_x)/seed_width_x;
+			float fy = (v.y-seed_min_y)/seed_width_y;
+			// Negated comparisons also catch NaN (zero width grid)
+			if (!(fx >= 0))
+				fx = 0;
+			if (!(fy >= 0))
+				fy = 0;
+			size_t x = std::min<float>( fx, noSeedCells-1 );
+			size_t y = std::min<float>( fy, noSeedCells-1 );
+			return x*noSeedCells+y;
+		}
+
+		uint32_t Delaunay::createNewTriangles( const Vertex &vertex,
+			uint32_t triangle ) {
+			for (uint32_t c=3*triangle; c<3*triangle+3; ++c) {
+				if (opposites[c] != noCorner &&
+						orient2d( this->vertex( next( c ) ), this->vertex( previous( c ) ),
+							vertex ) == 0)
+					return splitEdge( vertex, c );
 			}
 
+			uint32_t v = newVertex( vertex );
+
+			uint32_t c0 = 3*triangle;
+			uint32_t c0n = next( c0 );
+			uint32_t c0p = previous( c0 );
+			uint32_t old_vertex = corners[c0];
+			corners[c0] = v;
 
-			triangle->corners[0]->previous->opposite = c2n;
-			c2n->opposite = triangle->corners[0]->previous;
-			triangle->corners[0]->next->opposite = c1p;
-			c1p->opposite = triangle->corners[0]->next;
-			c1n->opposite = c2p;
-			c2p->opposite = c1n;
-			flipEdgesRecursively( triangle->corners[0] );
+			// Triangle 1 (vertex, previous, old vertex) and triangle 2 
+			// (vertex, old vertex, next)
+			uint32_t c1 = 3*newTriangle();
+			uint32_t c1n = c1+1;
+			uint32_t c1p = c1+2;
+			uint32_t c2 = 3*newTriangle();
+			uint32_t c2n = c2+1;
+			uint32_t c2p = c2+2;
+			corners[c1] = v;
+			corners[c1n] = corners[c0p];
+			corners[c1p] = old_vertex;
+			corners[c2] = v;
+			corners[c2n] = old_vertex;
+			corners[c2p] = corners[c0n];
+
+			//Opposites
+			setOpposites( c1, opposites[c0n] );
+			setOpposites( c2, opposites[c0p] );
+			setOpposites( c0p, c2n );
+			setOpposites( c0n, c1p );
+			setOpposites( c1n, c2p );
+
+			changedTriangles.push_back( triangle );
+			changedTriangles.push_back( Delaunay::triangle( c1 ) );
+			changedTriangles.push_back( Delaunay::triangle( c2 ) );
+
+			flipEdgesRecursively( c0 );
 			flipEdgesRecursively( c1 );
 			flipEdgesRecursively( c2 );
+			return v;
+		}
+
+		uint32_t Delaunay::splitEdge( const Vertex &vertex, uint32_t c ) {
+			uint32_t v = newVertex( vertex );
+
+			// Triangle (c, a, b) becomes (c, a, v) and (c, v, b),
+			// opposite triangle (o, b, a) becomes (o, b, v) and (o, v, a)
+			uint32_t o = opposites[c];
+			uint32_t cn = next( c );
+			uint32_t cp = previous( c );
+			uint32_t on = next( o );
+			uint32_t op = previous( o );
+			uint32_t a = corners[cn];
+			uint32_t b = corners[cp];
+			uint32_t ocn = opposites[cn];
+			uint32_t oon = opposites[on];
+
+			uint32_t c1 = 3*newTriangle();
+			uint32_t c1n = c1+1;
+			uint32_t c1p = c1+2;
+			uint32_t c2 = 3*newTriangle();
+			uint32_t c2n = c2+1;
+			uint32_t c2p = c2+2;
+			corners[c1] = corners[c];
+			corners[c1n] = v;
+			corners[c1p] = b;
+			corners[c2] = corners[o];
+			corners[c2n] = v;
+			corners[c2p] = a;
+			corners[cp] = v;
+			corners[op] = v;
+
+			setOpposites( c, c2 );
+			setOpposites( cn, c1p );
+			setOpposites( c1, o );
+			setOpposites( c1n, ocn );
+			setOpposites( on, c2p );
+			setOpposites( c2n, oon );
+
+			changedTriangles.push_back( triangle( c ) );
+			changedTriangles.push_back( triangle( c1 ) );
+			changedTriangles.push_back( triangle( o ) );
+			changedTriangles.push_back( triangle( c2 ) );
+
+			flipEdgesRecursively( cp );
+			flipEdgesRecursively( c1n );
+			flipEdgesRecursively( op );
+			flipEdgesRecursively( c2n );
+			return v;
 		}
 
-		void Delaunay::flipEdgesRecursively( boost::shared_ptr<Corner> pC, size_t count ) {
-			++count;
-			if (!pC->opposite || count > triangles.size()/2) {
-			} else {
-				// Check if pC->opposite is inside the circumcircle of pC->triangle
-				if (pC->triangle->inCircumCircle( pC->opposite->vertex ) )
-				{
-					// If so then flip (lot's of housekeeping again)
-					boost::shared_ptr<Corner> pCP = pC->previous;
-					boost::shared_ptr<Corner> pCN = pC->next;
-					boost::shared_ptr<Corner> pCO = pC->opposite;
-					boost::shared_ptr<Corner> pCON = pC->opposite->next;
-					boost::shared_ptr<Corner> pCOP = pC->opposite->previous;
-
-					boost::shared_ptr<Corner> pCOR = pC->opposite->previous->opposite;
-					boost::shared_ptr<Corner> pCOL = pC->opposite->next->opposite;
-					boost::shared_ptr<Corner> pCR = pC->previous->opposite;
-					boost::shared_ptr<Corner> pCL = pC->next->opposite;
-
-					pCN->vertex = pCO->vertex;
-					pCON->vertex = pC->vertex;
-
-
-					pC->opposite = pCOR;
-					if (pCOR) pCOR->opposite = pC;
-					pCP->opposite = pCOP;
-					pCOP->opposite = pCP;
-					pCON->opposite = pCOL;
-					if (pCOL) pCOL->opposite = pCON;
-					pCO->opposite = pCR;
-					if (pCR) pCR->opposite = pCO;
-					pCN->opposite = pCL;
-					if (pCL) pCL->opposite = pCN;
-
-					// Call flipEdgesRecursively for pC (with new triangle) 
-					// and old pC.o.n (now pC.p.o.p)
-					flipEdgesRecursively( pC, count );
-					flipEdgesRecursively( pCON, count );
+		void Delaunay::remove_data( uint32_t v ) {
+			if (v < 3 || v >= vertices.size())
+				return;
+			uint32_t tr = findTriangle( vertices[v] );
+			uint32_t c = noCorner;
+			for (uint32_t i=3*tr; i<3*tr+3; ++i) {
+				if (corners[i] == v)
+					c = i;
+			}
+			if (c == noCorner) // Not part of the triangulation
+				return;
+
+			// Walk counterclockwise around v, collecting the polygon of its 
+			// neighbours and the corner across each polygon edge
+			std::vector<uint32_t> slots;
+			std::vector<uint32_t> polygon;
+			std::vector<uint32_t> across;
+			uint32_t current = c;
+			do {
+				slots.push_back( triangle( current ) );
+				polygon.push_back( corners[next( current )] );
+				across.push_back( opposites[current] );
+				current = next( opposites[next( current )] );
+			} while (current != c);
+
+			// Fill the hole by cutting off ears whose circumcircle contains no other
+			// polygon vertex. Those are triangles of the new Delaunay triangulation.
+			size_t used = 0;
+			while (polygon.size() > 3) {
+				size_t n = polygon.size();
+				size_t ear = n;
+				for (size_t i=0; i<n && ear == n; ++i) {
+					const Vertex &a = vertices[polygon[i]];
+					const Vertex &b = vertices[polygon[(i+1)%n]];
+					const Vertex &d = vertices[polygon[(i+2)%n]];
+					if (orient2d( a, b, d ) <= 0)
+						continue;
+					ear = i;
+					for (size_t j=0; j<n; ++j) {
+						if (j != i && j != (i+1)%n && j != (i+2)%n &&
+								incircle( a, b, d, vertices[polygon[j]] ) > 0) {
+							ear = n;
+							break;
+						}
+					}
 				}
+				if (ear == n) // Can not happen with exact predicates
+					break;
+				size_t ib = (ear+1)%n;
+				size_t id = (ear+2)%n;
+				uint32_t c0 = 3*slots[used++];
+				corners[c0] = polygon[ear];
+				corners[c0+1] = polygon[ib];
+				corners[c0+2] = polygon[id];
+				setOpposites( c0+2, across[ear] );
+				setOpposites( c0, across[ib] );
+				// Edge from polygon[ear] to polygon[id] becomes part of the polygon
+				across[ear] = c0+1;
+				polygon.erase( polygon.begin()+ib );
+				across.erase( across.begin()+ib );
+			}
+			uint32_t c0 = 3*slots[used++];
+			for (size_t i=0; i<3; ++i)
+				corners[c0+i] = polygon[i];
+			setOpposites( c0, across[1] );
+			setOpposites( c0+1, across[2] );
+			setOpposites( c0+2, across[0] );
+
+			for (size_t i=0; i<used; ++i)
+				changedTriangles.push_back( slots[i] );
+			for (size_t i=used; i<slots.size(); ++i) {
+				for (uint32_t j=3*slots[i]; j<3*slots[i]+3; ++j) {
+					corners[j] = noCorner;
+					opposites[j] = noCorner;
+				}
+				freeTriangles.push_back( slots[i] );
+			}
+			freeVertices.push_back( v );
+			lastTriangle = slots[0];
+		}
+
+		bool Delaunay::contourSegment( uint32_t t, const std::vector<float> &heights,
+				float level, Vertex &from, Vertex &to ) const {
+			Vertex *ends[2] = { &from, &to };
+			size_t no_ends = 0;
+			for (uint32_t c=3*t; c<3*t+3; ++c) {
+				uint32_t a = corners[c];
+				uint32_t b = corners[next( c )];
+				if ((heights[a] >= level) == (heights[b] >= level))
+					continue;
+				// Interpolate in a fixed direction, so both triangles agree
+				if (b < a)
+					std::swap( a, b );
+				float f = (level-heights[a])/(heights[b]-heights[a]);
+				*ends[no_ends++] = vertices[a] + (vertices[b]-vertices[a]).scalar( f );
+			}
+			return no_ends == 2;
+		}
+
+		uint32_t Delaunay::newVertex( const Vertex &vertex ) {
+			if (freeVertices.empty()) {
+				vertices.push_back( vertex );
+				return vertices.size()-1;
+			}
+			uint32_t v = freeVertices.back();
+			freeVertices.pop_back();
+			vertices[v] = vertex;
+			return v;
+		}
+
+		uint32_t Delaunay::newTriangle() {
+			if (freeTriangles.empty()) {
+				corners.resize( corners.size()+3, noCorner );
+				opposites.resize( opposites.size()+3, noCorner );
+				return noTriangles()-1;
+			}
+			uint32_t t = freeTriangles.back();
+			freeTriangles.pop_back();
+			return t;
+		}
+
+		void Delaunay::flipEdgesRecursively( uint32_t c ) {
+			uint32_t co = opposites[c];
+			if (co == noCorner)
+				return;
+			// Check if the opposite is inside the circumcircle of the triangle of c
+			if (getTriangle( triangle( c ) ).inCircumCircle( vertex( co ) ) )
+			{
+				// If so then flip
+				uint32_t cp = previous( c );
+				uint32_t cn = next( c );
+				uint32_t con = next( co );
+				uint32_t cop = previous( co );
+
+				uint32_t cor = opposites[cop];
+				uint32_t col = opposites[con];
+				uint32_t cr = opposites[cp];
+				uint32_t cl = opposites[cn];
+
+				corners[cn] = corners[co];
+				corners[con] = corners[c];
+
+				setOpposites( c, cor );
+				setOpposites( cp, cop );
+				setOpposites( con, col );
+				setOpposites( co, cr );
+				setOpposites( cn, cl );
+
+				changedTriangles.push_back( triangle( c ) );
+				changedTriangles.push_back( triangle( co ) );
+
+				// Call flipEdgesRecursively for c (with new triangle) 
+				// and old c.o.n (now c.p.o.p)
+				flipEdgesRecursively( c );
+				flipEdgesRecursively( con );
 			}
 		}
 	};
@@ -432,15 +1118,14 @@ std::ostream & operator<<(std::ostream &out,
 
 std::ostream & operator<<(std::ostream &out,
 		const realtimeplot::delaunay::Edge &e ) {
-	out << (*e.pV0) << "--" << (*e.pV1);
+	out << e.v0 << "--" << e.v1;
 	return out;
 }
 std::ostream & operator<<(std::ostream &out,
 		const realtimeplot::delaunay::Triangle &t ) {
 	for (size_t i=0; i<2; ++i) {
-		out << (*t.corners[i]->vertex) << "--"; 
+		out << t.vertices[i] << "--"; 
 	}
-	out << (*t.corners[2]->vertex); 
+	out << t.vertices[2]; 
 	return out;
 }
-
@@ -26,37 +26,60 @@
 #include "realtimeplot/backend.h"
 
 namespace realtimeplot {
+	namespace {
+		//! Index of the WorkerPool worker running on this thread, if any
+		thread_local int worker_id = -1;
+	}
 
-	EventHandler::EventHandler()
+	EventHandler::EventHandler( bool pooled )
 		: processing_events( true ),
 		window_closed( false ),
-		event_queue( 1000 )
+		event_queue( 1000 ),
+		pooled( pooled ), scheduled( false ), finished( false )
 	{
 		//start processing thread
-		pEventProcessingThrd = boost::shared_ptr<boost::thread>( 
-				new boost::thread( boost::bind( 
-						&realtimeplot::EventHandler::process_events, this ) ) );
+		if (!pooled)
+			pEventProcessingThrd = boost::shared_ptr<boost::thread>( 
+					new boost::thread( boost::bind( 
+							&realtimeplot::EventHandler::process_events, this ) ) );
 	}
 
 	EventHandler::~EventHandler() {
-		if (pEventProcessingThrd->joinable())
+		if (pEventProcessingThrd && pEventProcessingThrd->joinable())
 			pEventProcessingThrd->join();
 	}
 
 	void EventHandler::add_event( boost::shared_ptr<Event> pEvent, 
 			bool high_priority ) {
 		event_queue.push( pEvent, high_priority );
+		if (pooled)
+			schedule();
 	}
 
 	int EventHandler::get_queue_size() {
 		return event_queue.size();
 	}
 
+	void EventHandler::join() {
+		if (pEventProcessingThrd) {
+			if (pEventProcessingThrd->joinable())
+				pEventProcessingThrd->join();
+			return;
+		}
+		boost::mutex::scoped_lock lock( finished_mutex );
+		while (!finished)
+			finished_cond.wait( lock );
+	}
+
+	void EventHandler::detach() {
+		if (pEventProcessingThrd)
+			pEventProcessingThrd->detach();
+	}
+
 	void EventHandler::process_events() {
 		//Ideally event queue would have a blocking get function
 		while ( processing_events || !window_closed ) {
-			boost::shared_ptr<Event> pEvent = event_queue.pop();
-			pEvent->execute( pBPlot );
+			process_event( event_queue.pop() );
 			if (get_queue_size() == 0) {
 				if (pBPlot != nullptr) {
 					pBPlot->display();
@@ -70,9 +93,122 @@ namespace realtimeplot {
 				window_closed = true;
 			}*/
 		}
+		finish();
+	}
+
+	void EventHandler::process_event( boost::shared_ptr<Event> pEvent ) {
+		pEvent->execute( pBPlot );
+	}
+
+	void EventHandler::process_batch() {
+		boost::shared_ptr<Event> pEvent;
+		size_t no_processed = 0;
+		size_t batch_size = WorkerPool::Instance()->batch_size;
+		while ( (processing_events || !window_closed) 
+				&& no_processed < batch_size 
+				&& event_queue.try_pop( pEvent ) ) {
+			process_event( pEvent );
+			++no_processed;
+		}
+		if (!processing_events && window_closed) {
+			// Stay scheduled, so we are never run again
+			finish();
+			return;
+		}
+		if (get_queue_size() == 0 && pBPlot != nullptr)
+			pBPlot->display();
+		scheduled = false;
+		// Events added after the check above would otherwise wait for the next one
+		if (get_queue_size() > 0)
+			schedule();
+	}
+
+	void EventHandler::schedule() {
+		if (!scheduled.exchange( true ))
+			WorkerPool::Instance()->schedule( shared_from_this() );
+	}
+
+	void EventHandler::finish() {
 		// Make sure we let pBPlot go/freed.
 		if (pBPlot != nullptr)
 			pBPlot.reset();
+		boost::mutex::scoped_lock lock( finished_mutex );
+		finished = true;
+		finished_cond.notify_all();
+	}
+
+	/*
+	 * WorkerPool
+	 */
+	WorkerPool* WorkerPool::pInstance = NULL;
+	boost::mutex WorkerPool::i_mutex;
+
+	WorkerPool* WorkerPool::Instance() {
+		i_mutex.lock();
+		if (pInstance == NULL) {
+			pInstance = new WorkerPool();
+		}
+		i_mutex.unlock();
+		return pInstance;
+	}
+
+	WorkerPool::WorkerPool() : batch_size( 64 ), next_worker( 0 ), 
+		no_scheduled( 0 ) {
+		no_threads = std::max<size_t>( 1, boost::thread::hardware_concurrency() );
+		for (size_t i = 0; i < no_threads; ++i)
+			workers.push_back( boost::shared_ptr<Worker>( new Worker() ) );
+		for (size_t i = 0; i < no_threads; ++i)
+			threads.create_thread( boost::bind( &WorkerPool::work, this, i ) );
+	}
+
+	void WorkerPool::schedule( boost::shared_ptr<EventHandler> pHandler ) {
+		// Keep rescheduled handlers local, spread the others round robin
+		size_t id = worker_id >= 0 ? worker_id : next_worker++ % no_threads;
+		{
+			boost::mutex::scoped_lock lock( workers[id]->mutex );
+			workers[id]->handlers.push_back( pHandler );
+		}
+		boost::mutex::scoped_lock lock( idle_mutex );
+		++no_scheduled;
+		handler_added.notify_one();
 	}
-}
 
+	boost::shared_ptr<EventHandler> WorkerPool::take( size_t id ) {
+		boost::shared_ptr<EventHandler> pHandler;
+		for (size_t i = 0; i < no_threads && !pHandler; ++i) {
+			Worker &worker = *workers[(id+i)%no_threads];
+			boost::mutex::scoped_lock lock( worker.mutex );
+			if (worker.handlers.empty())
+				continue;
+			if (i == 0) {
+				pHandler = worker.handlers.front();
+				worker.handlers.pop_front();
+			} else {
+				pHandler = worker.handlers.back();
+				worker.handlers.pop_back();
+			}
+		}
+		return pHandler;
+	}
+
+	void WorkerPool::work( size_t id ) {
+		worker_id = id;
+		for (;;) {
+			{
+				boost::mutex::scoped_lock lock( idle_mutex );
+				while (no_scheduled == 0)
+					handler_added.wait( lock );
+				// Claim one of the queued handlers
+				--no_scheduled;
+			}
+			boost::shared_ptr<EventHandler> pHandler = take( id );
+			// Another worker can have taken ours while stealing, then a handler
+			// that it claimed is still in one of the deques
+			while (!pHandler) {
+				boost::this_thread::yield();
+				pHandler = take( id );
+			}
+			pHandler->process_batch();
+		}
+	}
+}
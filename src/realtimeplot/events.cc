@@ -21,6 +21,8 @@
   -------------------------------------------------------------------
 */
 
+#include <cmath>
+
 #include "realtimeplot/events.h"
 
 namespace realtimeplot {
@@ -44,6 +46,15 @@ namespace realtimeplot {
         }
     }
 
+    bool MultipleEvents::droppable() const {
+        for (std::vector<boost::shared_ptr<Event> >::const_iterator it = events.begin(); 
+                it!=events.end(); ++it) {
+            if ((*it)->droppable())
+                return true;
+        }
+        return false;
+    }
+
 		OpenPlotEvent::OpenPlotEvent( PlotConfig plot_conf, 
 				boost::shared_ptr<EventHandler> pEventHandler ) :
 			plot_conf( plot_conf ),
@@ -104,6 +115,29 @@ namespace realtimeplot {
 		pBPlot->rectangle( min_x, min_y, width_x, width_y, fill, color );
 	}
 
+	GridEvent::GridEvent( float min_x, float min_y, float width_x, 
+			float width_y, size_t no_x, size_t no_y, 
+			const std::vector<size_t> &counts, size_t max_count )
+		: min_x( min_x ),
+		min_y( min_y ),
+		width_x( width_x ),
+		width_y( width_y ),
+		no_x( no_x ),
+		no_y( no_y ),
+		counts( counts ),
+		max_count( max_count )
+	{}
+
+	void GridEvent::execute( boost::shared_ptr<BackendPlot> &pBPlot )  const{
+		std::vector<uint32_t> colors( counts.size() );
+		double scale = max_count>0 ? 255.0/max_count : 0;
+		for (size_t i=0; i<counts.size(); ++i) {
+			uint32_t shade = 255 - lround( counts[i]*scale );
+			colors[i] = 0xff000000 | (shade<<16) | (shade<<8) | shade;
+		}
+		pBPlot->grid( min_x, min_y, width_x, width_y, no_x, no_y, colors );
+	}
+
 
 	LineAddEvent::LineAddEvent( float x, float y, int id_value, Color col ) {
 		x_crd = x;
@@ -117,12 +151,13 @@ namespace realtimeplot {
 	}
 
 
-	SaveEvent::SaveEvent( std::string fn ) {
+	SaveEvent::SaveEvent( std::string fn, SaveCallback callback ) 
+		: callback( callback ) {
 		filename = fn;
 	}
 
 	void SaveEvent::execute( boost::shared_ptr<BackendPlot> &pBPlot )  const{
-		pBPlot->save(filename);
+		pBPlot->save_async( filename, callback );
 	}
 
 	ClearEvent::ClearEvent() {
@@ -191,4 +226,26 @@ namespace realtimeplot {
 		boost::static_pointer_cast<BackendHeightMap, BackendPlot>(pBPlot)->add_data( x, y, z, show );
 	}
 
+	OpenGridHeightMapEvent::OpenGridHeightMapEvent( PlotConfig plot_conf, 
+			boost::shared_ptr<EventHandler> pEventHandler, 
+			size_t no_x, size_t no_y ) :
+		plot_conf( plot_conf ),
+		pEventHandler( pEventHandler ),
+		no_x( no_x ), no_y( no_y )
+	{}
+
+	void OpenGridHeightMapEvent::execute( boost::shared_ptr<BackendPlot> &pBPlot )  const{
+		pBPlot.reset( new BackendGridHeightMap( plot_conf, pEventHandler, no_x, no_y ) );
+	}
+
+	HMDataSetEvent::HMDataSetEvent( const std::vector<float> &xs, 
+			const std::vector<float> &ys, const std::vector<float> &zs, bool show )
+		: xs( xs ), ys( ys ), zs( zs ), show( show )
+	{}
+
+	void HMDataSetEvent::execute(boost::shared_ptr<BackendPlot> &pBPlot )  const{
+		boost::static_pointer_cast<BackendHeightMap, BackendPlot>(pBPlot)->set_data( 
+				xs, ys, zs, show );
+	}
+
 }
@@ -21,6 +21,8 @@
 	 -------------------------------------------------------------------
 	 */
 
+#include <cmath>
+
 #include "realtimeplot/plot.h"
 #include "realtimeplot/events.h"
 
@@ -48,6 +50,12 @@ namespace realtimeplot {
 			return false;
 	}
 
+	uint32_t Color::argb32() const {
+		uint32_t alpha = lround( 255*a );
+		return (alpha<<24) | (uint32_t(lround( 255*r*a ))<<16) 
+			| (uint32_t(lround( 255*g*a ))<<8) | uint32_t(lround( 255*b*a ));
+	}
+
 	Color Color::black() {
 		return Color( 0, 0, 0, 1 );
 	}
@@ -129,23 +137,72 @@ namespace realtimeplot {
 	/*
 	 * ColorMap
 	 */
+	const size_t ColorMap::lut_size;
+
 	ColorMap::ColorMap() :
 	 	alpha(-1), beta(-1), scaling( false ) 
-	{}
+	{
+		palette.push_back( Color::yellow() );
+		palette.push_back( Color::red() );
+		palette.push_back( Color::black() );
+		update_lut();
+	}
 
 	Color ColorMap::operator()( double proportion ) {
 		proportion = scale( proportion );
-		float r, g, b;
-		if (proportion < 0.5) {
-			r = 1;
-			g = 1-2*proportion;
-			b = 0;
-		} else {
-			r = 1-2*(proportion-0.5);
-			g = 0;
-			b = 0;
-		}
-		return Color( r, g, b, 1 );
+		if (palette.size() == 1 || !(proportion > 0))
+			return palette.front();
+		if (proportion >= 1)
+			return palette.back();
+		double position = proportion*(palette.size()-1);
+		size_t i = position;
+		float t = position - i;
+		const Color &c0 = palette[i];
+		const Color &c1 = palette[i+1];
+		return Color( c0.r+t*(c1.r-c0.r), c0.g+t*(c1.g-c0.g), 
+				c0.b+t*(c1.b-c0.b), c0.a+t*(c1.a-c0.a) );
+	}
+
+	size_t ColorMap::lut_index( double proportion ) const {
+		if (!(proportion > 0))
+			return 0;
+		if (proportion >= 1)
+			return lut_size-1;
+		return proportion*(lut_size-1)+0.5;
+	}
+
+	Color ColorMap::lookup( double proportion ) const {
+		uint32_t argb = lut[lut_index( proportion )];
+		double a = (argb>>24)/255.0;
+		if (a == 0)
+			return Color( 0, 0, 0, 0 );
+		return Color( ((argb>>16)&0xff)/(255.0*a), ((argb>>8)&0xff)/(255.0*a), 
+				(argb&0xff)/(255.0*a), a );
+	}
+
+	uint32_t ColorMap::argb32( double proportion ) const {
+		return lut[lut_index( proportion )];
+	}
+
+	void ColorMap::argb32( const std::vector<double> &proportions, 
+			std::vector<uint32_t> &colors ) const {
+		colors.resize( proportions.size() );
+		const uint32_t *table = &lut[0];
+		for (size_t i=0; i<proportions.size(); ++i)
+			colors[i] = table[lut_index( proportions[i] )];
+	}
+
+	void ColorMap::set_palette( const std::vector<Color> &new_palette ) {
+		if (new_palette.empty())
+			return;
+		palette = new_palette;
+		update_lut();
+	}
+
+	void ColorMap::update_lut() {
+		lut.resize( lut_size );
+		for (size_t i=0; i<lut_size; ++i)
+			lut[i] = (*this)( ((double) i)/(lut_size-1) ).argb32();
 	}
 
 	void ColorMap::calculate_height_scaling( double mean, double var ) {
@@ -159,6 +216,7 @@ namespace realtimeplot {
 			scaling = false;
 		else 
 			scaling = true;
+		update_lut();
 	}
 
 	double ColorMap::scale( double proportion ) {
@@ -196,6 +254,11 @@ namespace realtimeplot {
 		point_size = 4;
 		title = "RealTimePlot";
 		no_adaptive_events = 100;
+		keep_adapting = false;
+		frame_rate = 25;
+		png_compression_level = 6;
+		png_filters = 0;
+		worker_pool = false;
 	};
 
 	Plot::Plot()
@@ -207,10 +270,10 @@ namespace realtimeplot {
 					new AdaptiveOpenPlotEvent( config, pEventHandler ) ) );
 	}
 
-	Plot::Plot(bool open)
+	Plot::Plot(bool open, bool pooled)
 		: config( PlotConfig() ),
 			detach( false ), pEventHandler( new AdaptiveEventHandler( 
-						config.no_adaptive_events ) )
+						config.no_adaptive_events, pooled ) )
 	{ 
 		if (open)
 			pEventHandler->add_event( boost::shared_ptr<Event>( 
@@ -221,7 +284,7 @@ namespace realtimeplot {
 	Plot::Plot( PlotConfig conf )
 		: config( conf ),
 			detach( false ), pEventHandler( new AdaptiveEventHandler(
-						config.no_adaptive_events ) )
+						config.no_adaptive_events, config.worker_pool ) )
 	{ 
 		pEventHandler->add_event( boost::shared_ptr<Event>( 
 					new AdaptiveOpenPlotEvent( config, 
@@ -232,9 +295,9 @@ namespace realtimeplot {
 		pEventHandler->add_event( boost::shared_ptr<Event>( 
 					new FinalEvent(pEventHandler, false ) ) );
 		if (detach)
-			pEventHandler->pEventProcessingThrd->detach();
-		else if (pEventHandler->pEventProcessingThrd->joinable())
-			pEventHandler->pEventProcessingThrd->join();
+			pEventHandler->detach();
+		else
+			pEventHandler->join();
 	}
 
 
@@ -294,8 +357,8 @@ namespace realtimeplot {
 		pEventHandler->add_event( pEvent );
 	}
 
-	void Plot::save( std::string filename ) {
-		boost::shared_ptr<Event> pEvent( new SaveEvent( filename ));
+	void Plot::save( std::string filename, SaveCallback callback ) {
+		boost::shared_ptr<Event> pEvent( new SaveEvent( filename, callback ));
 		pEventHandler->add_event( pEvent );
 	}
 
@@ -344,8 +407,9 @@ namespace realtimeplot {
 	}
 
 	Histogram::Histogram( PlotConfig config, size_t no_bins, bool frequency )
-		: Plot( false ) 
+		: Plot( false, config.worker_pool )
 	{
+		this->config = config;
 		pEventHandler->add_event( boost::shared_ptr<Event>( 
 					new OpenHistogramEvent( config, 
 						frequency, no_bins, pEventHandler ) ) );
@@ -377,6 +441,27 @@ namespace realtimeplot {
 			plot();
 	}
 
+	void Histogram::set_data( size_t series, std::vector<double> the_data, 
+			bool show ) {
+		for (size_t i=0; i<the_data.size(); ++i) {
+			add_series_data( series, the_data[i], false );
+		}
+		if (show)
+			plot();
+	}
+
+	void Histogram::add_series_data( size_t series, double new_data, bool show ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new HistDataEvent( new_data, series ) ) ); 
+		if (show)
+			plot();
+	}
+
+	void Histogram::stack_series( bool stack ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new HistStackEvent( stack ) ) ); 
+	}
+
 	void Histogram::plot() {
 		pEventHandler->add_event( boost::shared_ptr<Event>( new HistPlotEvent() ) );
 	}
@@ -386,6 +471,26 @@ namespace realtimeplot {
 				 new HistOptimizeEvent(proportion) ) );
 	}
 
+	void Histogram::sliding_window( size_t no_samples, size_t no_slices ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>(
+				 new HistWindowEvent( false, no_samples, no_slices, false ) ) );
+	}
+
+	void Histogram::sliding_window_seconds( double seconds, size_t no_slices ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>(
+				 new HistWindowEvent( false, seconds, no_slices, true ) ) );
+	}
+
+	void Histogram::decaying_window( double half_life, size_t no_steps ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>(
+				 new HistWindowEvent( true, half_life, no_steps, false ) ) );
+	}
+
+	void Histogram::decaying_window_seconds( double half_life, size_t no_steps ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>(
+				 new HistWindowEvent( true, half_life, no_steps, true ) ) );
+	}
+
 	/*
 	 * Histogram3D
 	 */
@@ -401,8 +506,9 @@ namespace realtimeplot {
 
 	Histogram3D::Histogram3D( PlotConfig config,
 		 	size_t no_bins_x, size_t no_bins_y )
-		: Plot( false ) 
+		: Plot( false, config.worker_pool )
 	{
+		this->config = config;
 		pEventHandler->add_event( boost::shared_ptr<Event>( 
 					new OpenHistogram3DEvent( config, 
 						no_bins_x, no_bins_y, pEventHandler ) ) );
@@ -448,7 +554,7 @@ namespace realtimeplot {
 			size_t resolution )
 		: Plot(), resolution( resolution ),
 		data( resolution*resolution ), 
-		max_z( 1 ) 
+		max_z( 1 ), min_x( min_x ), min_y( min_y )
 	{ 
 		PlotConfig new_config = PlotConfig();
 		new_config.min_x = min_x;
@@ -459,31 +565,35 @@ namespace realtimeplot {
 		reset( new_config );
 		width_x = (max_x-min_x)/(resolution-1);
 		width_y = (max_y-min_y)/(resolution-1);
-		for (size_t i=0; i<(resolution); ++i) {
-			bins_x.push_back( min_x+width_x*i );
-			bins_y.push_back( min_y+width_y*i );
-			for (size_t j=0; j<(resolution); ++j) {
-				data[i*resolution+j] = 0;
-			}
-		}
+	}
+
+	SurfacePlot::SurfacePlot( PlotConfig config, size_t resolution )
+		: Plot( false, config.worker_pool ), resolution( resolution ),
+		data( resolution*resolution ), 
+		max_z( 1 ), min_x( config.min_x ), min_y( config.min_y )
+	{ 
+		this->config = config;
+		this->config.fixed_plot_area = true;
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new AdaptiveOpenPlotEvent( this->config, pEventHandler ) ) );
+		width_x = (config.max_x-config.min_x)/(resolution-1);
+		width_y = (config.max_y-config.min_y)/(resolution-1);
 	}
 
 	void SurfacePlot::add_data( float x, float y, bool show )
 	{
-		if (x > bins_x[0] && x < bins_x.back() && 
-				y > bins_y[0] && y < bins_y.back() ) {
-			for (size_t i=1; i<bins_x.size(); ++i) {
-				if (x < bins_x[i]) {
-					for (size_t j=1; j<bins_y.size(); ++j) {
-						if (y < bins_y[j]) {
-							++data[(i-1)*resolution+(j-1)];
-							if (data[(i-1)*resolution+(j-1)]>max_z)
-								++max_z;
-							break;
-						}
-					}
-					break;
-				}
+		// Check the bounds before casting, large or infinite values do not fit
+		// in a size_t
+		if (x > min_x && y > min_y && x < min_x + (resolution-1)*width_x
+				&& y < min_y + (resolution-1)*width_y) {
+			size_t i = (x-min_x)/width_x;
+			size_t j = (y-min_y)/width_y;
+			// The last row/column lies beyond max_x/max_y (rounding can still
+			// land on it)
+			if (i < resolution-1 && j < resolution-1) {
+				++data[i*resolution+j];
+				if (data[i*resolution+j]>max_z)
+					++max_z;
 			}
 		}
 		if (show)
@@ -491,13 +601,9 @@ namespace realtimeplot {
 	}
 
 	void SurfacePlot::plot() {
-		for (size_t i=0; i<bins_x.size(); ++i) {
-			for (size_t j=0; j<bins_y.size(); ++j) {
-				float shade = 1-double(data[i*resolution+j])/max_z;
-				Color color = Color( shade, shade, shade, 1 );
-				rectangle( bins_x[i], bins_y[j], width_x, width_y, true, color );
-			}
-		}
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new GridEvent( min_x, min_y, width_x, width_y, 
+						resolution, resolution, data, max_z ) ) );
 	}
 
 	HeightMap::HeightMap() : Plot(false)
@@ -522,14 +628,77 @@ namespace realtimeplot {
 						pEventHandler ) ) );
 	}
 
+	HeightMap::HeightMap( PlotConfig config ) : Plot( false, config.worker_pool )
+	{ 
+		this->config = config;
+		this->config.fixed_plot_area = true;
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new OpenHeightMapEvent( this->config, pEventHandler ) ) );
+	}
+
 	void HeightMap::add_data( float x, float y, float z, bool show ) {
 		pEventHandler->add_event( boost::shared_ptr<Event>( new HMDataEvent( x, y, z, show ) ) ); 
 	}
 
+	void HeightMap::set_data( const std::vector<float> &xs, 
+			const std::vector<float> &ys, const std::vector<float> &zs, bool show ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new HMDataSetEvent( xs, ys, zs, show ) ) ); 
+	}
+
+	void HeightMap::sliding_window( size_t max_points, double max_age ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new HMWindowEvent( max_points, max_age ) ) ); 
+	}
+
+	void HeightMap::contours( const std::vector<float> &levels, Color color ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new HMContoursEvent( levels, color ) ) ); 
+	}
+
 	void HeightMap::calculate_height_scaling() {
 		pEventHandler->add_event( boost::shared_ptr<Event>( 
 					new HMHeightScalingEvent() ) ); 
 	}
 
 
+	/*
+	 * GridHeightMap
+	 */
+	GridHeightMap::GridHeightMap( float min_x, float max_x, float min_y, float max_y,
+			size_t no_x, size_t no_y ) : Plot(false)
+	{ 
+		config.min_x = min_x;
+		config.max_x = max_x;
+		config.min_y = min_y;
+		config.max_y = max_y;
+		config.fixed_plot_area = true;
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new OpenGridHeightMapEvent( config, pEventHandler, no_x, no_y ) ) );
+	}
+
+	GridHeightMap::GridHeightMap( PlotConfig config, size_t no_x, size_t no_y ) 
+		: Plot( false, config.worker_pool )
+	{ 
+		this->config = config;
+		this->config.fixed_plot_area = true;
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new OpenGridHeightMapEvent( this->config, pEventHandler, 
+						no_x, no_y ) ) );
+	}
+
+	void GridHeightMap::add_data( float x, float y, float z, bool show ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new GridHMDataEvent( x, y, z, show ) ) ); 
+	}
+
+	void GridHeightMap::set_data( const std::vector<float> &zs, bool show ) {
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new GridHMSetDataEvent( zs, show ) ) ); 
+	}
+
+	void GridHeightMap::calculate_height_scaling() {
+		pEventHandler->add_event( boost::shared_ptr<Event>( 
+					new GridHMHeightScalingEvent() ) ); 
+	}
 }
@@ -21,6 +21,10 @@
 	 -------------------------------------------------------------------
 	 */
 
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
 #include "realtimeplot/plotarea.h"
 #include "realtimeplot/utils.h"
 
@@ -70,9 +74,12 @@ namespace realtimeplot {
 		min_y = config.min_y-yratio*(config.max_y-config.min_y);
 		max_y = config.max_y+yratio*(config.max_y-config.min_y);
 
-		surface = 
-			Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, 
-					width, height );
+		//Reuse the old surface if the size did not change, clear() paints all of it
+		if (!surface || surface->get_width() != (int) width 
+				|| surface->get_height() != (int) height)
+			surface = 
+				Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, 
+						width, height );
 
 		//Create context to draw background color
 		context = Cairo::Context::create(surface);
@@ -104,6 +111,206 @@ namespace realtimeplot {
 		context->restore();
 	}
 
+	void PlotArea::image( const Cairo::RefPtr<Cairo::ImageSurface> &image, 
+			float img_min_x, float img_min_y, float width_x, float width_y ) {
+		context->save();
+		// Image is drawn top down, so start at the top left corner
+		context->translate( img_min_x, img_min_y+width_y );
+		context->scale( width_x/image->get_width(), -width_y/image->get_height() );
+		Cairo::RefPtr<Cairo::SurfacePattern> pattern = 
+			Cairo::SurfacePattern::create( image );
+		pattern->set_filter( Cairo::FILTER_NEAREST );
+		context->set_source( pattern );
+		context->rectangle( 0, 0, image->get_width(), image->get_height() );
+		context->fill();
+		context->restore();
+	}
+
+	/**
+	 * \brief Everything needed to rasterise triangles into (part of) a surface
+	 *
+	 * Uses edge functions (half-space rasterisation) with pixel centers at 
+	 * (x+0.5, y+0.5) in device coordinates. A pixel on an edge shared by two 
+	 * triangles is only drawn by one of them.
+	 */
+	struct TriangleRaster {
+		const std::vector<delaunay::Vertex> *vertices;
+		const std::vector<float> *values;
+		const std::vector<uint32_t> *indices;
+		const std::vector<uint32_t> *lut;
+		// Plot units to device units and value to lookup table position
+		double scale_x, offset_x, scale_y, offset_y, scale_v, offset_v;
+		unsigned char *data;
+		int stride, width;
+
+		//! Does the (directed) edge a->b own pixels lying exactly on it
+		static bool owns( double ax, double ay, double bx, double by ) {
+			return (by > ay) || (by == ay && bx < ax);
+		}
+
+		void rasterise( int row_begin, int row_end ) const {
+			const double max_lut = lut->size()-1;
+			const uint32_t *table = &(*lut)[0];
+			for (size_t i=0; i+2<indices->size(); i+=3) {
+				double x[3], y[3], v[3];
+				for (size_t j=0; j<3; ++j) {
+					const delaunay::Vertex &vertex = (*vertices)[(*indices)[i+j]];
+					x[j] = vertex.x*scale_x+offset_x;
+					y[j] = vertex.y*scale_y+offset_y;
+					v[j] = (*values)[(*indices)[i+j]]*scale_v+offset_v;
+				}
+				double area = (x[1]-x[0])*(y[2]-y[0]) - (y[1]-y[0])*(x[2]-x[0]);
+				if (area == 0)
+					continue;
+				if (area < 0) {
+					std::swap( x[1], x[2] );
+					std::swap( y[1], y[2] );
+					std::swap( v[1], v[2] );
+					area = -area;
+				}
+
+				int min_col = std::max<double>( 0, floor( std::min( x[0], std::min( x[1], x[2] ) ) ) );
+				int max_col = std::min<double>( width-1, ceil( std::max( x[0], std::max( x[1], x[2] ) ) ) );
+				int min_row = std::max<double>( row_begin, floor( std::min( y[0], std::min( y[1], y[2] ) ) ) );
+				int max_row = std::min<double>( row_end-1, ceil( std::max( y[0], std::max( y[1], y[2] ) ) ) );
+				if (min_col > max_col || min_row > max_row)
+					continue;
+
+				// Edge k lies opposite to vertex k, w_k is the weight of vertex k
+				bool own[3];
+				double step_x[3], step_y[3];
+				for (size_t k=0; k<3; ++k) {
+					size_t a = (k+1)%3;
+					size_t b = (k+2)%3;
+					own[k] = owns( x[a], y[a], x[b], y[b] );
+					step_x[k] = -(y[b]-y[a]);
+					step_y[k] = x[b]-x[a];
+				}
+				double dv_dx = (step_x[0]*v[0]+step_x[1]*v[1]+step_x[2]*v[2])/area;
+
+				for (int row=min_row; row<=max_row; ++row) {
+					double py = row+0.5;
+					double px = min_col+0.5;
+					double w[3];
+					for (size_t k=0; k<3; ++k) {
+						size_t a = (k+1)%3;
+						w[k] = step_y[k]*(py-y[a]) + step_x[k]*(px-x[a]);
+					}
+					double value = (w[0]*v[0]+w[1]*v[1]+w[2]*v[2])/area;
+					uint32_t *pixels = reinterpret_cast<uint32_t*>( data+row*stride );
+					for (int col=min_col; col<=max_col; ++col) {
+						if ((w[0] > 0 || (w[0] == 0 && own[0])) &&
+								(w[1] > 0 || (w[1] == 0 && own[1])) &&
+								(w[2] > 0 || (w[2] == 0 && own[2]))) {
+							double pos = std::min( std::max( value, 0.0 ), max_lut );
+							pixels[col] = table[(size_t) (pos+0.5)];
+						}
+						w[0] += step_x[0];
+						w[1] += step_x[1];
+						w[2] += step_x[2];
+						value += dv_dx;
+					}
+				}
+			}
+		}
+	};
+
+	void PlotArea::triangles( const std::vector<delaunay::Vertex> &vertices,
+			const std::vector<float> &values, float min_value, float max_value,
+			const std::vector<uint32_t> &indices, const std::vector<uint32_t> &lut,
+			size_t no_threads ) {
+		if (indices.size() < 3 || lut.empty())
+			return;
+		TriangleRaster raster;
+		raster.vertices = &vertices;
+		raster.values = &values;
+		raster.indices = &indices;
+		raster.lut = &lut;
+		// Same transformation as transform_to_plot_units
+		raster.scale_x = ((double) width)/(max_x-min_x);
+		raster.offset_x = -min_x*raster.scale_x;
+		raster.scale_y = -((double) height)/(max_y-min_y);
+		raster.offset_y = height-min_y*raster.scale_y;
+		if (max_value > min_value)
+			raster.scale_v = (lut.size()-1)/(double(max_value)-min_value);
+		else
+			raster.scale_v = 0;
+		raster.offset_v = -min_value*raster.scale_v;
+
+		surface->flush();
+		raster.data = surface->get_data();
+		raster.stride = surface->get_stride();
+		raster.width = width;
+
+		if (no_threads == 0)
+			no_threads = std::max<size_t>( 1, boost::thread::hardware_concurrency() );
+		// Not worth starting threads for only a few triangles
+		if (indices.size() < 3*1024)
+			no_threads = 1;
+		if (no_threads == 1) {
+			raster.rasterise( 0, height );
+		} else {
+			size_t band = (height+no_threads-1)/no_threads;
+			boost::thread_group threads;
+			for (size_t i=0; i<no_threads; ++i) {
+				threads.create_thread( boost::bind( &TriangleRaster::rasterise, &raster, 
+							i*band, std::min( height, (i+1)*band ) ) );
+			}
+			threads.join_all();
+		}
+		surface->mark_dirty();
+	}
+
+	void PlotArea::bilinear( const std::vector<float> &values, size_t no_x, size_t no_y,
+			float grid_min_x, float grid_min_y, float width_x, float width_y,
+			float min_value, float max_value, const std::vector<uint32_t> &lut,
+			size_t first_x, size_t last_x, size_t first_y, size_t last_y ) {
+		if (no_x < 2 || no_y < 2 || lut.empty() || first_x > last_x || first_y > last_y)
+			return;
+		// Same transformation as transform_to_plot_units
+		double scale_x = ((double) width)/(max_x-min_x);
+		double scale_y = -((double) height)/(max_y-min_y);
+		double offset_y = height-min_y*scale_y;
+		double scale_v = 0;
+		if (max_value > min_value)
+			scale_v = (lut.size()-1)/(double(max_value)-min_value);
+		const double max_lut = lut.size()-1;
+
+		// Pixels with their center inside the cells
+		double x0 = (grid_min_x+first_x*width_x-min_x)*scale_x;
+		double x1 = (grid_min_x+last_x*width_x-min_x)*scale_x;
+		double y0 = (grid_min_y+last_y*width_y)*scale_y+offset_y;
+		double y1 = (grid_min_y+first_y*width_y)*scale_y+offset_y;
+		int min_col = std::max<double>( 0, ceil( x0-0.5 ) );
+		int max_col = std::min<double>( ((double) width)-1, floor( x1-0.5 ) );
+		int min_row = std::max<double>( 0, ceil( y0-0.5 ) );
+		int max_row = std::min<double>( ((double) height)-1, floor( y1-0.5 ) );
+		if (min_col > max_col || min_row > max_row)
+			return;
+
+		surface->flush();
+		unsigned char *data = surface->get_data();
+		int stride = surface->get_stride();
+		const float *z = &values[0];
+		const uint32_t *table = &lut[0];
+		for (int row=min_row; row<=max_row; ++row) {
+			double v = (((row+0.5)-offset_y)/scale_y-grid_min_y)/width_y;
+			size_t j = std::min<double>( std::max( floor( v ), 0.0 ), no_y-2 );
+			double fy = v-j;
+			uint32_t *pixels = reinterpret_cast<uint32_t*>( data+row*stride );
+			for (int col=min_col; col<=max_col; ++col) {
+				double u = ((col+0.5)/scale_x+min_x-grid_min_x)/width_x;
+				size_t i = std::min<double>( std::max( floor( u ), 0.0 ), no_x-2 );
+				double fx = u-i;
+				double value = (1-fx)*((1-fy)*z[i*no_y+j] + fy*z[i*no_y+j+1])
+					+ fx*((1-fy)*z[(i+1)*no_y+j] + fy*z[(i+1)*no_y+j+1]);
+				double pos = std::min( std::max( (value-min_value)*scale_v, 0.0 ), max_lut );
+				pixels[col] = table[(size_t) (pos+0.5)];
+			}
+		}
+		surface->mark_dirty();
+	}
+
 	void PlotArea::point( float x, float y ) {
 		double dx = point_size;
 		double dy = point_size;
@@ -111,6 +318,22 @@ namespace realtimeplot {
 		rectangle( x-0.5*dx, y-0.5*dy, dx, dy, true );
 	}
 
+	void PlotArea::segments( const std::vector<delaunay::Vertex> &ends, 
+			const Color &color ) {
+		if (ends.size() < 2)
+			return;
+		context->save();
+		transform_to_plot_units();
+		context->set_source_rgba( color.r, color.g, color.b, color.a );
+		for (size_t i=0; i+1<ends.size(); i+=2) {
+			context->move_to( ends[i].x, ends[i].y );
+			context->line_to( ends[i+1].x, ends[i+1].y );
+		}
+		transform_to_device_units();
+		context->stroke();
+		context->restore();
+	}
+
 	void PlotArea::line_add( float x, float y, int id ) {
 		if (lines.count( id )) {
 			auto line = lines[id];
@@ -180,6 +403,16 @@ namespace realtimeplot {
 		lines.clear();
 	}
 
+	void PlotArea::clear( float rect_min_x, float rect_min_y,
+			float width_x, float width_y ) {
+		context->save();
+		context->set_antialias( Cairo::ANTIALIAS_NONE );
+		context->set_source_rgba( 1, 1, 1, 1 );
+		context->rectangle( rect_min_x, rect_min_y, width_x, width_y );
+		context->fill();
+		context->restore();
+	}
+
 	/*
 	 * AxesArea
 	 */
@@ -210,9 +443,19 @@ namespace realtimeplot {
 		std::vector<double> yaxis_ticks;
 
 
-		surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, 
+		if (!surface || surface->get_width() != (int) width 
+				|| surface->get_height() != (int) height) {
+			surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, 
 					width, height );
-		context = Cairo::Context::create(surface);
+			context = Cairo::Context::create(surface);
+		} else {
+			//Same size: wipe the old axes instead of allocating a new surface
+			context = Cairo::Context::create(surface);
+			context->save();
+			context->set_operator( Cairo::OPERATOR_CLEAR );
+			context->paint();
+			context->restore();
+		}
 
 		int text_width, text_height;
 		Glib::RefPtr<Pango::Layout> pango_layout = Pango::Layout::create(context);
@@ -0,0 +1,175 @@
+/*
+	 -------------------------------------------------------------------
+
+	 Copyright (C) 2010, Edwin van Leeuwen
+
+	 This file is part of RealTimePlot.
+
+	 RealTimePlot is free software; you can redistribute it and/or modify
+	 it under the terms of the GNU General Public License as published by
+	 the Free Software Foundation; either version 3 of the License, or
+	 (at your option) any later version.
+
+	 RealTimePlot is distributed in the hope that it will be useful,
+	 but WITHOUT ANY WARRANTY; without even the implied warranty of
+	 MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	 GNU General Public License for more details.
+
+	 You should have received a copy of the GNU General Public License
+	 along with RealTimePlot. If not, see <http://www.gnu.org/licenses/>.
+
+	 -------------------------------------------------------------------
+	 */
+#include <cstdio>
+#include <stdint.h>
+#include <algorithm>
+
+#include <png.h>
+#include <boost/bind.hpp>
+
+#include "realtimeplot/pngwriter.h"
+#include "realtimeplot/utils.h"
+
+namespace realtimeplot {
+	PngImage::PngImage( int width, int height ) : width( width ), height( height ),
+		stride( 4*width ), data( 4*width*height ) {
+	}
+
+	/*
+	 * PngJobCounter
+	 */
+	void PngJobCounter::wait() {
+		boost::mutex::scoped_lock lock( mutex );
+		while (no_pending > 0)
+			all_done.wait( lock );
+	}
+
+	void PngJobCounter::add() {
+		boost::mutex::scoped_lock lock( mutex );
+		++no_pending;
+	}
+
+	void PngJobCounter::done() {
+		boost::mutex::scoped_lock lock( mutex );
+		if (--no_pending == 0)
+			all_done.notify_all();
+	}
+
+	/*
+	 * PngWriter
+	 */
+	PngWriter* PngWriter::pInstance = NULL;
+	boost::mutex PngWriter::i_mutex;
+
+	PngWriter* PngWriter::Instance() {
+		i_mutex.lock();
+		if (pInstance == NULL) {
+			pInstance = new PngWriter();
+		}
+		i_mutex.unlock();
+		return pInstance;
+	}
+
+	PngWriter::PngWriter() : no_active( 0 ) {
+		// Leave a core for the event and X threads
+		no_threads = std::max<size_t>( 1, boost::thread::hardware_concurrency()/2 );
+		max_queued = 2*no_threads;
+		for (size_t i = 0; i < no_threads; ++i)
+			workers.create_thread( boost::bind( &PngWriter::work, this ) );
+	}
+
+	bool PngWriter::add( boost::shared_ptr<PngImage> pImage, std::string filename,
+			int compression_level, int filters, SaveCallback callback,
+			bool droppable, boost::shared_ptr<PngJobCounter> pCounter ) {
+		boost::mutex::scoped_lock lock( mutex );
+		if (droppable && jobs.size() >= max_queued)
+			return false;
+		if (pCounter)
+			pCounter->add();
+		Job job;
+		job.pImage = pImage;
+		job.filename = filename;
+		job.compression_level = compression_level;
+		job.filters = filters;
+		job.callback = callback;
+		job.pCounter = pCounter;
+		jobs.push_back( job );
+		job_added.notify_one();
+		return true;
+	}
+
+	void PngWriter::wait() {
+		boost::mutex::scoped_lock lock( mutex );
+		while (!jobs.empty() || no_active > 0)
+			job_done.wait( lock );
+	}
+
+	void PngWriter::work() {
+		for (;;) {
+			Job job;
+			{
+				boost::mutex::scoped_lock lock( mutex );
+				while (jobs.empty())
+					job_added.wait( lock );
+				job = jobs.front();
+				jobs.pop_front();
+				++no_active;
+			}
+			bool success = write( *job.pImage, job.filename,
+					job.compression_level, job.filters );
+			if (!success)
+				fprintf( stderr, "Unable to write %s\n", job.filename.c_str() );
+			if (job.callback)
+				job.callback( job.filename, success );
+			// Free the pixels before reporting we are done
+			job.pImage.reset();
+			if (job.pCounter)
+				job.pCounter->done();
+			boost::mutex::scoped_lock lock( mutex );
+			--no_active;
+			job_done.notify_all();
+		}
+	}
+
+	bool PngWriter::write( const PngImage &image, const std::string &filename,
+			int compression_level, int filters ) {
+		FILE *fp = fopen( filename.c_str(), "wb" );
+		if (!fp)
+			return false;
+
+		png_structp png = png_create_write_struct( PNG_LIBPNG_VER_STRING,
+				NULL, NULL, NULL );
+		png_infop info = png ? png_create_info_struct( png ) : NULL;
+		if (!info) {
+			png_destroy_write_struct( &png, NULL );
+			fclose( fp );
+			return false;
+		}
+		std::vector<unsigned char> row( 4*image.width );
+		// libpng jumps back here on errors
+		if (setjmp( png_jmpbuf( png ) )) {
+			png_destroy_write_struct( &png, &info );
+			fclose( fp );
+			return false;
+		}
+
+		png_init_io( png, fp );
+		png_set_compression_level( png,
+				std::min( 9, std::max( 0, compression_level ) ) );
+		if (filters != 0)
+			png_set_filter( png, PNG_FILTER_TYPE_BASE, filters );
+		png_set_IHDR( png, info, image.width, image.height, 8,
+				PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+				PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
+		png_write_info( png, info );
+
+		for (int j = 0; j < image.height; ++j) {
+			utils::argb_to_rgba( (const uint32_t *) (&image.data[0] + j*image.stride),
+					image.width, &row[0] );
+			png_write_row( png, &row[0] );
+		}
+		png_write_end( png, NULL );
+		png_destroy_write_struct( &png, &info );
+		return fclose( fp ) == 0;
+	}
+}
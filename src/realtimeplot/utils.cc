@@ -21,6 +21,8 @@
 	 -------------------------------------------------------------------
 	 */
 #include <limits>
+#include <algorithm>
+#include <cmath>
 #include "realtimeplot/utils.h"
 
 #include <sstream>
@@ -106,6 +108,132 @@ namespace realtimeplot {
 			return range;
 		}
 
+		/*
+		 * WindowedBins
+		 */
+		WindowedBins::WindowedBins() : decaying( false ), no_slices( 1 ),
+			period( 1 ), factor( 1 ), current_slice( 0 ),
+			next_rotation( 1 ), sum( 0 )
+		{}
+
+		void WindowedBins::set_sliding( size_t no_bins, size_t slices_in_window,
+				double rotation_period ) {
+			decaying = false;
+			no_slices = std::max<size_t>( 1, slices_in_window );
+			period = rotation_period;
+			factor = 1;
+			totals.assign( no_bins, 0 );
+			slices.assign( no_bins*no_slices, 0 );
+			clear();
+		}
+
+		void WindowedBins::set_decaying( size_t no_bins, double decay_factor,
+				double rotation_period ) {
+			decaying = true;
+			no_slices = 1;
+			period = rotation_period;
+			factor = decay_factor;
+			totals.assign( no_bins, 0 );
+			slices.clear();
+			clear();
+		}
+
+		void WindowedBins::add( size_t bin, double clock, double weight ) {
+			advance( clock );
+			totals[bin] += weight;
+			sum += weight;
+			if (!decaying)
+				slices[current_slice*totals.size()+bin] += weight;
+		}
+
+		void WindowedBins::advance( double clock ) {
+			if (clock < next_rotation)
+				return;
+			size_t no_rotations = 1 + (clock-next_rotation)/period;
+			next_rotation += no_rotations*period;
+			rotate( no_rotations );
+		}
+
+		void WindowedBins::rotate( size_t no_rotations ) {
+			if (decaying) {
+				double f = std::pow( factor, (double) no_rotations );
+				for (auto & count : totals)
+					count *= f;
+				sum *= f;
+				return;
+			}
+
+			if (no_rotations >= no_slices) {
+				std::fill( totals.begin(), totals.end(), 0 );
+				std::fill( slices.begin(), slices.end(), 0 );
+				sum = 0;
+				return;
+			}
+
+			size_t no_bins = totals.size();
+			for (size_t r=0; r<no_rotations; ++r) {
+				current_slice = (current_slice+1)%no_slices;
+				double *slice = &slices[current_slice*no_bins];
+				for (size_t i=0; i<no_bins; ++i) {
+					totals[i] -= slice[i];
+					sum -= slice[i];
+					slice[i] = 0;
+				}
+			}
+		}
+
+		void WindowedBins::resize( size_t no_bins ) {
+			size_t old_no_bins = totals.size();
+			if (!decaying) {
+				std::vector<double> resized( no_bins*no_slices );
+				size_t no_copy = std::min( old_no_bins, no_bins );
+				for (size_t i=0; i<no_slices; ++i)
+					std::copy( slices.begin()+i*old_no_bins, 
+							slices.begin()+i*old_no_bins+no_copy,
+							resized.begin()+i*no_bins );
+				slices.swap( resized );
+			}
+			for (size_t i=no_bins; i<old_no_bins; ++i)
+				sum -= totals[i];
+			totals.resize( no_bins );
+		}
+
+		void WindowedBins::clear() {
+			std::fill( totals.begin(), totals.end(), 0 );
+			std::fill( slices.begin(), slices.end(), 0 );
+			current_slice = 0;
+			next_rotation = period;
+			sum = 0;
+		}
+
+		const std::vector<double> &WindowedBins::bins() const {
+			return totals;
+		}
+
+		double WindowedBins::total() const {
+			return sum;
+		}
+
+		void argb_to_rgba( const uint32_t *pixels, size_t width, 
+				unsigned char *rgba ) {
+			for (size_t i = 0; i < width; ++i) {
+				uint32_t pixel = pixels[i];
+				unsigned int a = pixel >> 24;
+				unsigned int r = (pixel >> 16) & 0xff;
+				unsigned int g = (pixel >> 8) & 0xff;
+				unsigned int b = pixel & 0xff;
+				if (a != 0 && a != 255) {
+					r = (r*255 + a/2)/a;
+					g = (g*255 + a/2)/a;
+					b = (b*255 + a/2)/a;
+				}
+				rgba[4*i] = r;
+				rgba[4*i+1] = g;
+				rgba[4*i+2] = b;
+				rgba[4*i+3] = a;
+			}
+		}
+
 		std::string stringify(double x)
 		{
 			std::ostringstream o;
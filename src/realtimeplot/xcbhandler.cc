@@ -21,7 +21,17 @@
   -------------------------------------------------------------------
 */
 
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
 #include "realtimeplot/xcbhandler.h"
+#include "realtimeplot/utils.h"
 
 #ifndef NO_X
 #include <xcb/xcb_keysyms.h>
@@ -33,6 +43,12 @@
 #endif
 
 #include <cairomm/xcb_surface.h>
+
+#ifndef NO_SHM
+#include <cstdlib>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
 #endif
 
 #include "realtimeplot/events.h"
@@ -138,6 +154,12 @@ namespace realtimeplot {
 				"WM_DELETE_WINDOW");
 		reply2 = xcb_intern_atom_reply(connection, cookie2, 0);
 
+#ifndef NO_SHM
+		shm_available = check_shm();
+#else
+		shm_available = false;
+#endif
+
 		pXEventProcessingThrd = boost::shared_ptr<boost::thread>( 
 				new boost::thread( boost::bind( 
 						&realtimeplot::XcbHandler::process_xevents, this ) ) );
@@ -148,129 +170,398 @@ namespace realtimeplot {
 		xcb_generic_event_t *event;
 
 		bool move_tracking = false;
-		size_t last_tracked_x=0, last_tracked_y=0;
+		int last_tracked_x=0, last_tracked_y=0;
+		// Bounding box (min_x, min_y, max_x, max_y) of the exposed parts per window
+		std::map<xcb_window_t, std::vector<int> > damage;
+		// Keysym table is only refreshed when the keyboard mapping changes
+		xcb_key_symbols_t *p_symbols = xcb_key_symbols_alloc(connection);
 		while ((event = xcb_wait_for_event (connection))) {
-			switch(XCB_EVENT_RESPONSE_TYPE(event)) {
-				case XCB_CLIENT_MESSAGE:
-					xcb_client_message_event_t* msg;
-					msg = (xcb_client_message_event_t *)event;
-					if(msg->data.data32[0] ==
-							reply2->atom)
-					{
-						send_event( msg->window, boost::shared_ptr<Event>( 
-									new CloseWindowEvent() ) ); 
-					}
-					break;
-				case XCB_UNMAP_WINDOW:
-					break;
-				case XCB_CONFIGURE_NOTIFY:
-					xcb_configure_notify_event_t *conf;
-					conf = (xcb_configure_notify_event_t *)event;
-					send_event( conf->window, boost::shared_ptr<Event>( 
-								new ScaleXSurfaceEvent( conf->width, conf->height ) ) ); 
-					break;
-				case XCB_EXPOSE:
-					xcb_expose_event_t *expose;
-					expose = (xcb_expose_event_t *)event;
-					send_event( expose->window, boost::shared_ptr<Event>( 
-						new DisplayEvent() ) ); 
-					//display();
-					break;
-				case XCB_KEY_PRESS:
-					/* Handle the Key Press event type */
-					xcb_key_press_event_t *ev;
-					ev = (xcb_key_press_event_t *)event;
-					xcb_key_symbols_t *p_symbols;
-					p_symbols = xcb_key_symbols_alloc(connection);
-					xcb_keysym_t key;
-					key = xcb_key_symbols_get_keysym(p_symbols,ev->detail,0);
-					if (key == XK_space)  {
-						send_event( ev->event, boost::shared_ptr<Event>( 
-								new PauseEvent() ) ); 
-					}
-					else if (key == XK_w)  {
-						send_event( ev->event, boost::shared_ptr<Event>( 
-									new SaveEvent( "realtimeplot.png" ) ) );
-					}
-					else if (key == XK_Left) {
-						send_event( ev->event, boost::shared_ptr<Event>( 
-									new MoveEvent( -1, 0 ) ) );
-					} else if (key == XK_Right) {
-						send_event( ev->event, boost::shared_ptr<Event>( 
-									new MoveEvent( 1, 0 ) ) );
-					} else if (key == XK_Up) {
-						send_event( ev->event, boost::shared_ptr<Event>( 
-									new MoveEvent( 0, 1 ) ) );
-					} else if (key == XK_Down) {
-						send_event( ev->event, boost::shared_ptr<Event>( 
-									new MoveEvent( 0, -1 ) ) );
-					} else if (key == XK_KP_Add) { 
-						send_event( ev->event, boost::shared_ptr<Event>( 
-									new ZoomEvent( 0.95 ) ) );
-					} else if (key == XK_KP_Subtract) { 
-						send_event( ev->event, boost::shared_ptr<Event>( 
-									new ZoomEvent( 1/0.95 ) ) );
-					}
-					xcb_key_symbols_free( p_symbols );
-					break;
-				case XCB_BUTTON_PRESS:
-					xcb_button_press_event_t *bp;
-					bp = (xcb_button_press_event_t *)event;
-					switch (bp->detail) {
-						case 4:
-							send_event( bp->event, boost::shared_ptr<Event>( 
-										new ZoomAroundPixelEvent( 0.95, bp->event_x, bp->event_y ) ) );
-							break;
-						case 5:
-							send_event( bp->event, boost::shared_ptr<Event>( 
-										new ZoomAroundPixelEvent( 1/0.95, bp->event_x, bp->event_y ) ) );
-							break;
-						case 3:
-							move_tracking = true;
-							last_tracked_x = bp->event_x;
-							last_tracked_y = bp->event_y;
-							break;
-						default:
-							break;
-					}
-					break;
-				case XCB_BUTTON_RELEASE: 
-					xcb_button_release_event_t *br;
-					br = (xcb_button_release_event_t *) event;
-					switch (br->detail) {
-						case 3:
-							move_tracking = false;
-							break;
-						default:
-							break;
-					}
-					break;
-				case XCB_MOTION_NOTIFY: // Mouse motion tracking 
-					if (move_tracking) {
-						xcb_motion_notify_event_t *motion;
-						motion = (xcb_motion_notify_event_t *) event;
-						send_event( motion->event, boost::shared_ptr<Event>( 
-									new MovePixelsEvent( last_tracked_x-motion->event_x, 
-										last_tracked_y-motion->event_y ) ) );
-						last_tracked_x = motion->event_x;
-						last_tracked_y = motion->event_y;
-					}
-					break;
-				default:
-					break;
+			// Runs of motion and configure events are combined per window and
+			// forwarded once all queued events are handled. A pending size is 
+			// forwarded earlier if an expose repair of its window comes first
+			std::map<xcb_window_t, std::pair<int, int> > moves;
+			std::map<xcb_window_t, std::pair<int, int> > sizes;
+			do {
+				switch(XCB_EVENT_RESPONSE_TYPE(event)) {
+					case XCB_CLIENT_MESSAGE:
+						xcb_client_message_event_t* msg;
+						msg = (xcb_client_message_event_t *)event;
+						if(msg->data.data32[0] ==
+								reply2->atom)
+						{
+							send_event( msg->window, boost::shared_ptr<Event>( 
+										new CloseWindowEvent() ) ); 
+						}
+						break;
+					case XCB_UNMAP_WINDOW:
+						break;
+					case XCB_CONFIGURE_NOTIFY:
+						xcb_configure_notify_event_t *conf;
+						conf = (xcb_configure_notify_event_t *)event;
+						sizes[conf->window] = std::make_pair( 
+								(int) conf->width, (int) conf->height );
+						break;
+					case XCB_EXPOSE:
+						xcb_expose_event_t *expose;
+						expose = (xcb_expose_event_t *)event;
+						{
+							std::vector<int> &box = damage[expose->window];
+							if (box.empty()) {
+								box.push_back( expose->x );
+								box.push_back( expose->y );
+								box.push_back( expose->x+expose->width );
+								box.push_back( expose->y+expose->height );
+							} else {
+								box[0] = std::min<int>( box[0], expose->x );
+								box[1] = std::min<int>( box[1], expose->y );
+								box[2] = std::max<int>( box[2], expose->x+expose->width );
+								box[3] = std::max<int>( box[3], expose->y+expose->height );
+							}
+							// More expose events for this window follow
+							if (expose->count > 0)
+								break;
+							// The plot has to know the new size before it repairs the window
+							std::map<xcb_window_t, std::pair<int, int> >::iterator size = 
+								sizes.find( expose->window );
+							if (size != sizes.end()) {
+								send_event( size->first, boost::shared_ptr<Event>( 
+											new ScaleXSurfaceEvent( size->second.first, 
+												size->second.second ) ) ); 
+								sizes.erase( size );
+							}
+							send_event( expose->window, boost::shared_ptr<Event>( 
+										new DisplayRegionEvent( box[0], box[1], 
+											box[2]-box[0], box[3]-box[1] ) ) ); 
+							damage.erase( expose->window );
+						}
+						break;
+					case XCB_KEY_PRESS:
+						/* Handle the Key Press event type */
+						xcb_key_press_event_t *ev;
+						ev = (xcb_key_press_event_t *)event;
+						xcb_keysym_t key;
+						key = xcb_key_symbols_get_keysym(p_symbols,ev->detail,0);
+						if (key == XK_space)  {
+							send_event( ev->event, boost::shared_ptr<Event>( 
+									new PauseEvent() ) ); 
+						}
+						else if (key == XK_w)  {
+							send_event( ev->event, boost::shared_ptr<Event>( 
+										new SaveEvent( "realtimeplot.png" ) ) );
+						}
+						else if (key == XK_r)  {
+							send_event( ev->event, boost::shared_ptr<Event>( 
+										new RecordEvent() ) );
+						}
+						else if (key == XK_Left) {
+							send_event( ev->event, boost::shared_ptr<Event>( 
+										new MoveEvent( -1, 0 ) ) );
+						} else if (key == XK_Right) {
+							send_event( ev->event, boost::shared_ptr<Event>( 
+										new MoveEvent( 1, 0 ) ) );
+						} else if (key == XK_Up) {
+							send_event( ev->event, boost::shared_ptr<Event>( 
+										new MoveEvent( 0, 1 ) ) );
+						} else if (key == XK_Down) {
+							send_event( ev->event, boost::shared_ptr<Event>( 
+										new MoveEvent( 0, -1 ) ) );
+						} else if (key == XK_KP_Add) { 
+							send_event( ev->event, boost::shared_ptr<Event>( 
+										new ZoomEvent( 0.95 ) ) );
+						} else if (key == XK_KP_Subtract) { 
+							send_event( ev->event, boost::shared_ptr<Event>( 
+										new ZoomEvent( 1/0.95 ) ) );
+						}
+						break;
+					case XCB_MAPPING_NOTIFY:
+						xcb_refresh_keyboard_mapping( p_symbols, 
+								(xcb_mapping_notify_event_t *)event );
+						break;
+					case XCB_BUTTON_PRESS:
+						xcb_button_press_event_t *bp;
+						bp = (xcb_button_press_event_t *)event;
+						switch (bp->detail) {
+							case 4:
+								send_event( bp->event, boost::shared_ptr<Event>( 
+											new ZoomAroundPixelEvent( 0.95, bp->event_x, bp->event_y ) ) );
+								break;
+							case 5:
+								send_event( bp->event, boost::shared_ptr<Event>( 
+											new ZoomAroundPixelEvent( 1/0.95, bp->event_x, bp->event_y ) ) );
+								break;
+							case 3:
+								move_tracking = true;
+								last_tracked_x = bp->event_x;
+								last_tracked_y = bp->event_y;
+								break;
+							default:
+								break;
+						}
+						break;
+					case XCB_BUTTON_RELEASE: 
+						xcb_button_release_event_t *br;
+						br = (xcb_button_release_event_t *) event;
+						switch (br->detail) {
+							case 3:
+								move_tracking = false;
+								break;
+							default:
+								break;
+						}
+						break;
+					case XCB_MOTION_NOTIFY: // Mouse motion tracking 
+						if (move_tracking) {
+							xcb_motion_notify_event_t *motion;
+							motion = (xcb_motion_notify_event_t *) event;
+							std::pair<int, int> &move = moves[motion->event];
+							move.first += last_tracked_x-motion->event_x;
+							move.second += last_tracked_y-motion->event_y;
+							last_tracked_x = motion->event_x;
+							last_tracked_y = motion->event_y;
+						}
+						break;
+					default:
+						break;
+				}
+				free(event);
+			} while ((event = xcb_poll_for_queued_event (connection)));
+
+			for (std::map<xcb_window_t, std::pair<int, int> >::iterator it = 
+					sizes.begin(); it != sizes.end(); ++it)
+				send_event( it->first, boost::shared_ptr<Event>( 
+							new ScaleXSurfaceEvent( it->second.first, it->second.second ) ) ); 
+			for (std::map<xcb_window_t, std::pair<int, int> >::iterator it = 
+					moves.begin(); it != moves.end(); ++it) {
+				if (it->second.first != 0 || it->second.second != 0)
+					send_event( it->first, boost::shared_ptr<Event>( 
+								new MovePixelsEvent( it->second.first, it->second.second ) ) );
 			}
 		}
-		free(event);
+		xcb_key_symbols_free( p_symbols );
 	}
 	
 	Cairo::RefPtr<Cairo::Surface> XcbHandler::get_cairo_surface( size_t window_id, 
 			size_t width, size_t height ) {
-		boost::mutex::scoped_lock( map_mutex );
-		xcb_drawable_t draw = mapWindowId[window_id];
-		return Cairo::XcbSurface::create( connection, draw, 
+		boost::mutex::scoped_lock lock( map_mutex );
+		xcb_drawable_t win = mapWindowId[window_id];
+		if (shm_available)
+			return Cairo::XcbSurface::create( connection, win, 
+					visual_type, width, height );
+		BackBuffer &buffer = mapBackBuffer[window_id];
+		if (!buffer.pixmap || width > buffer.pixmap_width 
+				|| height > buffer.pixmap_height 
+				|| 2*width < buffer.pixmap_width || 2*height < buffer.pixmap_height) {
+			free_back_buffer( buffer );
+			// Leave some room, so resizing the window a bit keeps the pixmap
+			buffer.pixmap_width = width + width/4;
+			buffer.pixmap_height = height + height/4;
+			buffer.pixmap = xcb_generate_id( connection );
+			xcb_create_pixmap( connection, screen->root_depth, buffer.pixmap, win,
+					buffer.pixmap_width, buffer.pixmap_height );
+			buffer.gc = xcb_generate_id( connection );
+			xcb_create_gc( connection, buffer.gc, win, 0, NULL );
+		}
+		buffer.width = width;
+		buffer.height = height;
+		return Cairo::XcbSurface::create( connection, buffer.pixmap, 
 				visual_type, width, height );
 	}
 
+	void XcbHandler::free_back_buffer( BackBuffer &buffer ) {
+		if (buffer.pixmap) {
+			xcb_free_pixmap( connection, buffer.pixmap );
+			xcb_free_gc( connection, buffer.gc );
+			buffer.pixmap = 0;
+		}
+	}
+
+	bool XcbHandler::copy_back_buffer( size_t window_id, 
+			int x, int y, int width, int height ) {
+		boost::mutex::scoped_lock lock( map_mutex );
+		std::map<size_t, BackBuffer>::iterator it = mapBackBuffer.find( window_id );
+		if (it == mapBackBuffer.end() || !it->second.pixmap)
+			return false;
+		BackBuffer &buffer = it->second;
+		// Clip to the part in use
+		width = std::min<int>( x+width, buffer.width ) - std::max( x, 0 );
+		height = std::min<int>( y+height, buffer.height ) - std::max( y, 0 );
+		x = std::max( x, 0 );
+		y = std::max( y, 0 );
+		if (width > 0 && height > 0) {
+			xcb_copy_area( connection, buffer.pixmap, mapWindowId[window_id], 
+					buffer.gc, x, y, x, y, width, height );
+			xcb_flush( connection );
+		}
+		return true;
+	}
+
+
+#ifndef NO_SHM
+	bool XcbHandler::check_shm() {
+		if (getenv( "REALTIMEPLOT_NO_SHM" ))
+			return false;
+		const xcb_query_extension_reply_t *extension = 
+			xcb_get_extension_data( connection, &xcb_shm_id );
+		if (!extension || !extension->present)
+			return false;
+		xcb_shm_query_version_reply_t *version = xcb_shm_query_version_reply( 
+				connection, xcb_shm_query_version( connection ), NULL );
+		if (!version)
+			return false;
+		free( version );
+
+		// Cairo RGB24 pixels are native endian 32 bit 0x00rrggbb
+		if (screen->root_depth != 24 || !visual_type 
+				|| visual_type->red_mask != 0xff0000 
+				|| visual_type->green_mask != 0xff00
+				|| visual_type->blue_mask != 0xff)
+			return false;
+		const uint32_t probe = 1;
+		uint8_t host_order = *((const uint8_t *) &probe) ? 
+			XCB_IMAGE_ORDER_LSB_FIRST : XCB_IMAGE_ORDER_MSB_FIRST;
+		if (xcb_get_setup( connection )->image_byte_order != host_order)
+			return false;
+		xcb_format_iterator_t format_iter = 
+			xcb_setup_pixmap_formats_iterator( xcb_get_setup( connection ) );
+		for (; format_iter.rem; xcb_format_next( &format_iter )) {
+			if (format_iter.data->depth == 24)
+				return format_iter.data->bits_per_pixel == 32;
+		}
+		return false;
+	}
+
+	bool XcbHandler::create_shm_image( size_t window_id, ShmImage &image, 
+			size_t width, size_t height ) {
+		int stride = Cairo::ImageSurface::format_stride_for_width( 
+				Cairo::FORMAT_RGB24, width );
+		int shmid = shmget( IPC_PRIVATE, stride*height, IPC_CREAT | 0600 );
+		if (shmid < 0)
+			return false;
+		void *data = shmat( shmid, NULL, 0 );
+		if (data == (void *) -1) {
+			shmctl( shmid, IPC_RMID, NULL );
+			return false;
+		}
+
+		image.seg = xcb_generate_id( connection );
+		xcb_generic_error_t *error = xcb_request_check( connection, 
+				xcb_shm_attach_checked( connection, image.seg, shmid, 0 ) );
+		// Segment is destroyed once both sides have detached
+		shmctl( shmid, IPC_RMID, NULL );
+		if (error) {
+			// For example a display on another machine
+			free( error );
+			shmdt( data );
+			return false;
+		}
+
+		image.data = (unsigned char *) data;
+		image.width = width;
+		image.height = height;
+		image.pending = false;
+		image.gc = xcb_generate_id( connection );
+		map_mutex.lock();
+		xcb_create_gc( connection, image.gc, mapWindowId[window_id], 0, NULL );
+		map_mutex.unlock();
+		image.surface = Cairo::ImageSurface::create( image.data, 
+				Cairo::FORMAT_RGB24, width, height, stride );
+		return true;
+	}
+
+	void XcbHandler::wait_for_shm_image( ShmImage &image ) {
+		if (image.pending) {
+			// Any round trip will do, the server handles requests in order
+			free( xcb_get_input_focus_reply( connection, 
+						xcb_get_input_focus( connection ), NULL ) );
+			image.pending = false;
+		}
+	}
+
+	void XcbHandler::put_shm_image( size_t window_id, ShmImage &image,
+			int x, int y, int width, int height ) {
+		// Clip to the image
+		width = std::min<int>( x+width, image.width ) - std::max( x, 0 );
+		height = std::min<int>( y+height, image.height ) - std::max( y, 0 );
+		x = std::max( x, 0 );
+		y = std::max( y, 0 );
+		if (width <= 0 || height <= 0)
+			return;
+		map_mutex.lock();
+		xcb_drawable_t win = mapWindowId[window_id];
+		map_mutex.unlock();
+		xcb_shm_put_image( connection, win, image.gc, 
+				image.width, image.height, x, y, width, height, x, y,
+				screen->root_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, image.seg, 0 );
+		xcb_flush( connection );
+		image.pending = true;
+	}
+
+	void XcbHandler::free_shm_image( ShmImage &image ) {
+		if (!image.data)
+			return;
+		wait_for_shm_image( image );
+		image.surface.clear();
+		xcb_shm_detach( connection, image.seg );
+		xcb_free_gc( connection, image.gc );
+		xcb_flush( connection );
+		shmdt( image.data );
+		image.data = NULL;
+	}
+#endif
+
+	Cairo::RefPtr<Cairo::ImageSurface> XcbHandler::get_present_surface( 
+			size_t window_id, size_t width, size_t height ) {
+#ifndef NO_SHM
+		if (shm_available) {
+			boost::mutex::scoped_lock lock( shm_mutex );
+			ShmImage &image = mapShm[window_id];
+			if (image.data && image.width == width && image.height == height) {
+				wait_for_shm_image( image );
+				return image.surface;
+			}
+			free_shm_image( image );
+			if (create_shm_image( window_id, image, width, height ))
+				return image.surface;
+			// Fall back to sending frames over the socket from now on
+			shm_available = false;
+		}
+#endif
+		return Cairo::RefPtr<Cairo::ImageSurface>();
+	}
+
+	void XcbHandler::present( size_t window_id ) {
+#ifndef NO_SHM
+		{
+			boost::mutex::scoped_lock lock( shm_mutex );
+			std::map<size_t, ShmImage>::iterator it = mapShm.find( window_id );
+			if (it != mapShm.end() && it->second.data) {
+				it->second.surface->flush();
+				put_shm_image( window_id, it->second, 0, 0, 
+						it->second.width, it->second.height );
+				return;
+			}
+		}
+#endif
+		copy_back_buffer( window_id, 0, 0, 
+				std::numeric_limits<int>::max(), std::numeric_limits<int>::max() );
+	}
+
+	bool XcbHandler::present_region( size_t window_id, 
+			int x, int y, int width, int height ) {
+#ifndef NO_SHM
+		{
+			boost::mutex::scoped_lock lock( shm_mutex );
+			std::map<size_t, ShmImage>::iterator it = mapShm.find( window_id );
+			if (it != mapShm.end() && it->second.data) {
+				// The image still holds the last presented frame
+				put_shm_image( window_id, it->second, x, y, width, height );
+				return true;
+			}
+		}
+#endif
+		// As does the back buffer
+		return copy_back_buffer( window_id, x, y, width, height );
+	}
 
 	void XcbHandler::set_title( size_t window_id, std::string title ) {
 		xcb_change_property_checked (connection, XCB_PROP_MODE_REPLACE, 
@@ -280,7 +571,19 @@ namespace realtimeplot {
 	}
 
 	void XcbHandler::close_window( size_t window_id ) {
-		boost::mutex::scoped_lock( map_mutex );
+#ifndef NO_SHM
+		shm_mutex.lock();
+		if (mapShm.count( window_id )) {
+			free_shm_image( mapShm[window_id] );
+			mapShm.erase( window_id );
+		}
+		shm_mutex.unlock();
+#endif
+		boost::mutex::scoped_lock lock( map_mutex );
+		if (mapBackBuffer.count( window_id )) {
+			free_back_buffer( mapBackBuffer[window_id] );
+			mapBackBuffer.erase( window_id );
+		}
 		xcb_drawable_t win = mapWindowId[window_id];
 			xcb_unmap_window( connection, win );
 		xcb_destroy_window( connection, win );
@@ -348,4 +651,175 @@ namespace realtimeplot {
 	void DummyHandler::set_title( size_t window_id, std::string title ) {}
 	void DummyHandler::close_window( size_t window_id ) {}
 
+	// FrameSinkHandler
+	FrameSinkHandler::FrameSinkHandler( std::string path, double frame_rate ) 
+		: DisplayHandler(), no_frames_written( 0 ), path( path ), 
+		frame_rate( frame_rate > 0 ? frame_rate : 25 ),
+		drawing( -1 ), latest( -1 ), writing( -1 ), latest_new( false ),
+		stop( false ), output( NULL ), width( 0 ), height( 0 )
+	{
+		y4m = path.size() >= 4 && path.compare( path.size()-4, 4, ".y4m" ) == 0;
+		pWriterThrd = boost::shared_ptr<boost::thread>( 
+				new boost::thread( boost::bind( 
+						&realtimeplot::FrameSinkHandler::write_frames, this ) ) );
+	}
+
+	FrameSinkHandler::~FrameSinkHandler() {
+		close_window( 0 );
+	}
+
+	size_t FrameSinkHandler::open_window( size_t width, size_t height,
+			boost::shared_ptr<EventHandler> pEventHandler ) {
+		return 0;
+	}
+
+	Cairo::RefPtr<Cairo::Surface> 
+		FrameSinkHandler::get_cairo_surface( size_t window_id, 
+				size_t width, size_t height ) {
+			return Cairo::ImageSurface::create( Cairo::FORMAT_ARGB32, width, height );
+		}
+
+	Cairo::RefPtr<Cairo::ImageSurface> FrameSinkHandler::get_present_surface( 
+			size_t window_id, size_t width, size_t height ) {
+		boost::mutex::scoped_lock lock( ring_mutex );
+		// Any image that is neither the last frame nor being written
+		drawing = 0;
+		while (drawing == latest || drawing == writing)
+			++drawing;
+		Cairo::RefPtr<Cairo::ImageSurface> &image = ring[drawing];
+		if (!image || image->get_width() != (int) width 
+				|| image->get_height() != (int) height)
+			image = Cairo::ImageSurface::create( Cairo::FORMAT_ARGB32, width, height );
+		return image;
+	}
+
+	void FrameSinkHandler::present( size_t window_id ) {
+		boost::mutex::scoped_lock lock( ring_mutex );
+		if (drawing < 0)
+			return;
+		latest = drawing;
+		drawing = -1;
+		latest_new = true;
+	}
+
+	void FrameSinkHandler::close_window( size_t window_id ) {
+		ring_mutex.lock();
+		stop = true;
+		ring_mutex.unlock();
+		if (pWriterThrd->joinable())
+			pWriterThrd->join();
+	}
+
+	void FrameSinkHandler::write_frames() {
+		// A reader that goes away makes writes fail with EPIPE, instead of 
+		// killing the process with SIGPIPE
+		sigset_t sigpipe;
+		sigemptyset( &sigpipe );
+		sigaddset( &sigpipe, SIGPIPE );
+		pthread_sigmask( SIG_BLOCK, &sigpipe, NULL );
+
+		boost::posix_time::time_duration period = 
+			boost::posix_time::microseconds( (int64_t) (1e6/frame_rate) );
+		boost::posix_time::ptime next = boost::posix_time::microsec_clock::local_time();
+		while (true) {
+			boost::posix_time::time_duration wait = 
+				next - boost::posix_time::microsec_clock::local_time();
+			if (!wait.is_negative())
+				boost::this_thread::sleep( wait );
+			next += period;
+
+			ring_mutex.lock();
+			if (stop) {
+				// Make sure the final state of the plot ends up in the output
+				writing = latest_new ? latest : -1;
+				latest_new = false;
+				ring_mutex.unlock();
+				if (writing >= 0)
+					write_frame( ring[writing] );
+				break;
+			}
+			// Repeat the last frame if nothing new was presented
+			writing = latest;
+			latest_new = false;
+			ring_mutex.unlock();
+
+			bool success = writing < 0 || write_frame( ring[writing] );
+
+			ring_mutex.lock();
+			writing = -1;
+			if (!success) {
+				stop = true;
+				latest_new = false;
+			}
+			ring_mutex.unlock();
+		}
+		if (output) {
+			fclose( output );
+			output = NULL;
+		}
+	}
+
+	bool FrameSinkHandler::write_frame( Cairo::RefPtr<Cairo::ImageSurface> frame ) {
+		frame->flush();
+		int w = frame->get_width();
+		int h = frame->get_height();
+		if (!output) {
+			// Opening a FIFO blocks until there is a reader, unless non blocking
+			int fd = open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 
+					0666 );
+			if (fd < 0 && errno == ENXIO)
+				return true; // No reader yet, try again with the next frame
+			if (fd >= 0) {
+				// Frames are written whole, so block while writing
+				fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) & ~O_NONBLOCK );
+				output = fdopen( fd, "wb" );
+				if (!output)
+					close( fd );
+			}
+			if (!output) {
+				fprintf( stderr, "Unable to open %s for writing frames\n", path.c_str() );
+				return false;
+			}
+			width = w;
+			height = h;
+			if (y4m)
+				fprintf( output, "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C444\n",
+						width, height, (int) (frame_rate*1000+0.5) );
+		}
+		if (w != width || h != height)
+			return true;
+
+		buffer.resize( (y4m ? 3 : 4)*w*h );
+		const unsigned char *data = frame->get_data();
+		int stride = frame->get_stride();
+		for (int j = 0; j < h; ++j) {
+			const uint32_t *pixels = (const uint32_t *) (data + j*stride);
+			if (!y4m) {
+				utils::argb_to_rgba( pixels, w, &buffer[4*j*w] );
+				continue;
+			}
+			row.resize( 4*w );
+			utils::argb_to_rgba( pixels, w, &row[0] );
+			for (int i = 0; i < w; ++i) {
+				int r = row[4*i];
+				int g = row[4*i+1];
+				int b = row[4*i+2];
+				size_t k = j*w+i;
+				// BT.601, studio range
+				buffer[k] = ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+				buffer[w*h+k] = ((-38*r - 74*g + 112*b + 128) >> 8) + 128;
+				buffer[2*w*h+k] = ((112*r - 94*g - 18*b + 128) >> 8) + 128;
+			}
+		}
+		if ((y4m && fputs( "FRAME\n", output ) < 0)
+				|| fwrite( &buffer[0], 1, buffer.size(), output ) != buffer.size()
+				|| fflush( output ) != 0) {
+			fprintf( stderr, "Unable to write frames to %s, stopped writing\n", 
+					path.c_str() );
+			return false;
+		}
+		++no_frames_written;
+		return true;
+	}
+
 };
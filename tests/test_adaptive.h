@@ -75,9 +75,7 @@ class TestAdaptive : public CxxTest::TestSuite
 						new FinalEvent(pEventHandler, false ) ) );
 			pEventHandler->pEventProcessingThrd->join();
 			TS_ASSERT_EQUALS( pEventHandler->get_queue_size(), 0 );
-			pEventHandler->proc_mutex.lock();
 			TS_ASSERT_EQUALS( pEventHandler->processed_events.size(), 3 );
-			pEventHandler->proc_mutex.unlock();
 		}
 
 		void testAEHreprocess() {
@@ -148,6 +146,32 @@ class TestAdaptive : public CxxTest::TestSuite
 			pEventHandler->pEventProcessingThrd->join();
 		}
 
+		void testAEHKeepAdapting() {
+			boost::shared_ptr<AdaptiveEventHandler> pEventHandler( 
+				new AdaptiveEventHandler( 10 ) );
+			pEventHandler->keep_adapting = true;
+			pEventHandler->add_event( boost::shared_ptr<Event>( 
+						new OpenPlotEvent( conf, pEventHandler ) ) );
+			for (size_t i = 0; i < 100; ++i) {
+				pEventHandler->add_event( 
+						boost::shared_ptr<Event>( new PointEvent(i, i) ) ); 
+			}
+			pEventHandler->add_event( boost::shared_ptr<Event>( 
+						new FinalEvent(pEventHandler, false ) ) );
+			// The kept events are only safe to touch once the thread is done
+			pEventHandler->pEventProcessingThrd->join();
+
+			TS_ASSERT( pEventHandler->adaptive );
+			TS_ASSERT_LESS_THAN_EQUALS( pEventHandler->processed_events.size(), 10 );
+			TS_ASSERT_LESS_THAN_EQUALS( 5, pEventHandler->processed_events.size() );
+
+			// Smaller depth thins out the kept events instead of clearing them
+			pEventHandler->set_max_no_events( 6 );
+			TS_ASSERT( pEventHandler->adaptive );
+			TS_ASSERT_LESS_THAN_EQUALS( pEventHandler->processed_events.size(), 6 );
+			TS_ASSERT_LESS_THAN_EQUALS( 3, pEventHandler->processed_events.size() );
+		}
+
 		/*
 		 * Adaptive plot
 		 */
@@ -162,42 +186,47 @@ class TestAdaptive : public CxxTest::TestSuite
 			TS_ASSERT( check_plot( "empty_plot" ) );
 		}
 
-		void testAdapt() {
+		void testGrow() {
 			BackendAdaptivePlot bpl = BackendAdaptivePlot( conf, 
 					boost::shared_ptr<EventHandler>() );
 			bpl.max_data_x = bpl.min_data_x;
 			bpl.max_data_y = bpl.min_data_y;
-			bpl.adapt();
+			bpl.grow();
 			TS_ASSERT_EQUALS( bpl.config.max_x, 0.5 );
 			TS_ASSERT_EQUALS( bpl.config.min_x, -0.5 );
 			TS_ASSERT_EQUALS( bpl.config.max_y, 0.5 );
 			TS_ASSERT_EQUALS( bpl.config.min_y, -0.5 );
 			bpl.max_data_x = 1;
 			bpl.max_data_y = 5;
-			bpl.adapt();
-			TS_ASSERT_DELTA( bpl.config.max_x, 1.2, 0.0001 );
-			TS_ASSERT_DELTA( bpl.config.min_x, -0.2, 0.0001 );
-			TS_ASSERT_EQUALS( bpl.config.max_y, 6 );
-			TS_ASSERT_EQUALS( bpl.config.min_y, -1 );
+			bpl.grow();
+			// At least the old range
+			TS_ASSERT_DELTA( bpl.config.max_x, 1.5, 0.0001 );
+			TS_ASSERT_DELTA( bpl.config.min_x, -0.5, 0.0001 );
+			// At least a margin around the data
+			TS_ASSERT_DELTA( bpl.config.max_y, 6, 0.0001 );
+			TS_ASSERT_DELTA( bpl.config.min_y, -0.5, 0.0001 );
 		}
 
-		void testAdaptCloseValues() {
+		void testGrowCloseValues() {
 			BackendAdaptivePlot bpl = BackendAdaptivePlot( conf, 
 					boost::shared_ptr<EventHandler>() );
 			bpl.max_data_x = bpl.min_data_x;
 			bpl.max_data_y = bpl.min_data_y;
-			bpl.adapt();
+			bpl.grow();
+			// Still inside, so nothing changes
+			bpl.max_data_x = 0.1;
+			bpl.max_data_y = 0.5;
+			bpl.grow();
 			TS_ASSERT_EQUALS( bpl.config.max_x, 0.5 );
 			TS_ASSERT_EQUALS( bpl.config.min_x, -0.5 );
 			TS_ASSERT_EQUALS( bpl.config.max_y, 0.5 );
 			TS_ASSERT_EQUALS( bpl.config.min_y, -0.5 );
-			bpl.max_data_x = 0.1;
-			bpl.max_data_y = 0.5;
-			bpl.adapt();
-			TS_ASSERT_DELTA( bpl.config.max_x, 0.12, 0.0001 );
-			TS_ASSERT_DELTA( bpl.config.min_x, -0.02, 0.0001 );
-			TS_ASSERT_DELTA( bpl.config.max_y, 0.6, 0.0001 );
-			TS_ASSERT_DELTA( bpl.config.min_y, -0.1, 0.0001 );
+			bpl.min_data_x = -0.6;
+			bpl.grow();
+			TS_ASSERT_EQUALS( bpl.config.max_x, 0.5 );
+			TS_ASSERT_DELTA( bpl.config.min_x, -1.5, 0.0001 );
+			TS_ASSERT_EQUALS( bpl.config.max_y, 0.5 );
+			TS_ASSERT_EQUALS( bpl.config.min_y, -0.5 );
 		}
 
 
@@ -210,10 +239,10 @@ class TestAdaptive : public CxxTest::TestSuite
 			TS_ASSERT_EQUALS( bpl.config.max_y, 0.5 );
 			TS_ASSERT_EQUALS( bpl.config.min_y, -0.5 );
 			bpl.within_plot_bounds( 1, 5 );
-			TS_ASSERT_DELTA( bpl.config.max_x, 1.2, 0.0001 );
-			TS_ASSERT_DELTA( bpl.config.min_x, -0.2, 0.0001 );
-			TS_ASSERT_EQUALS( bpl.config.max_y, 6 );
-			TS_ASSERT_EQUALS( bpl.config.min_y, -1 );
+			TS_ASSERT_DELTA( bpl.config.max_x, 1.5, 0.0001 );
+			TS_ASSERT_DELTA( bpl.config.min_x, -0.5, 0.0001 );
+			TS_ASSERT_DELTA( bpl.config.max_y, 6, 0.0001 );
+			TS_ASSERT_DELTA( bpl.config.min_y, -0.5, 0.0001 );
 		}
 
 		void testWithinBoundsCloseValues() {
@@ -224,11 +253,16 @@ class TestAdaptive : public CxxTest::TestSuite
 			TS_ASSERT_EQUALS( bpl.config.min_x, -0.5 );
 			TS_ASSERT_EQUALS( bpl.config.max_y, 0.5 );
 			TS_ASSERT_EQUALS( bpl.config.min_y, -0.5 );
+			// Still inside, so nothing changes
 			bpl.within_plot_bounds( 0.1, 0.5 );
-			TS_ASSERT_DELTA( bpl.config.max_x, 0.12, 0.0001 );
-			TS_ASSERT_DELTA( bpl.config.min_x, -0.02, 0.0001 );
-			TS_ASSERT_DELTA( bpl.config.max_y, 0.6, 0.0001 );
-			TS_ASSERT_DELTA( bpl.config.min_y, -0.1, 0.0001 );
+			TS_ASSERT_EQUALS( bpl.config.max_x, 0.5 );
+			TS_ASSERT_EQUALS( bpl.config.min_x, -0.5 );
+			TS_ASSERT_EQUALS( bpl.config.max_y, 0.5 );
+			TS_ASSERT_EQUALS( bpl.config.min_y, -0.5 );
+			bpl.within_plot_bounds( 0.6, 0.5 );
+			TS_ASSERT_DELTA( bpl.config.max_x, 1.5, 0.0001 );
+			TS_ASSERT_DELTA( bpl.config.min_x, -0.5, 0.0001 );
+			TS_ASSERT_EQUALS( bpl.config.max_y, 0.5 );
 		}
 
 
@@ -259,14 +293,55 @@ class TestAdaptive : public CxxTest::TestSuite
 			TS_ASSERT_EQUALS( pEH->pBPlot->config.min_x, -0.5 );
 			pEH->add_event( boost::shared_ptr<Event>( 
 						new PointEvent( -1, -5 ) ) );
-			TS_ASSERT_DELTA( pEH->pBPlot->config.min_x, -1.2, 0.0001 );
+			TS_ASSERT_DELTA( pEH->pBPlot->config.min_x, -1.5, 0.0001 );
 			pEH->adaptive = false;
 			pEH->pBPlot->config.fixed_plot_area = true; // Stop rolling updates from occuring
 			pEH->add_event( boost::shared_ptr<Event>( 
 						new PointEvent( -3, -5 ) ) );
-			TS_ASSERT_DELTA( pEH->pBPlot->config.min_x, -1.2, 0.0001 );
+			TS_ASSERT_DELTA( pEH->pBPlot->config.min_x, -1.5, 0.0001 );
 			pEH->pBPlot->save( fn( "adaptive_plot" ) );
 			TS_ASSERT( check_plot( "adaptive_plot" ) );
 		}
 
+		void testKeepThinnedOutlier() {
+			boost::shared_ptr<MockAdaptiveEventHandler2> pEH(
+					new MockAdaptiveEventHandler2() ); 
+			pEH->add_event( boost::shared_ptr<Event>( 
+						new AdaptiveOpenPlotEvent( conf, pEH ) ) );
+			pEH->keep_adapting = true;
+			pEH->stride = 4;
+			pEH->process_event( boost::shared_ptr<Event>( 
+						new PointEvent( 0, 0 ) ) );
+			TS_ASSERT_EQUALS( pEH->processed_events.size(), 2 );
+			// Thinned out, but it grows the region so it has to be kept
+			pEH->process_event( boost::shared_ptr<Event>( 
+						new PointEvent( 100, 0 ) ) );
+			TS_ASSERT_EQUALS( pEH->processed_events.size(), 3 );
+			TS_ASSERT( pEH->pBPlot->config.max_x >= 100 );
+			// Thinned out and inside the region
+			pEH->process_event( boost::shared_ptr<Event>( 
+						new PointEvent( 50, 0 ) ) );
+			TS_ASSERT_EQUALS( pEH->processed_events.size(), 3 );
+			// Events that grew the region survive decimation
+			TS_ASSERT( !pEH->processed_events[1]->droppable() );
+			TS_ASSERT( !pEH->processed_events[2]->droppable() );
+		}
+
+		void testGrowGeometrically() {
+			boost::shared_ptr<MockAdaptiveEventHandler2> pEH(
+					new MockAdaptiveEventHandler2() ); 
+			pEH->add_event( boost::shared_ptr<Event>( 
+						new AdaptiveOpenPlotEvent( conf, pEH ) ) );
+			for (size_t i = 0; i < 1000; ++i)
+				pEH->add_event( boost::shared_ptr<Event>( 
+							new PointEvent( i, 0 ) ) );
+			TS_ASSERT( pEH->pBPlot->config.max_x >= 999 );
+			// Range doubles on each adaptation
+			TS_ASSERT_LESS_THAN( pEH->no_reprocess, 15 );
+			// Reset to the same size keeps the surfaces
+			Cairo::RefPtr<Cairo::ImageSurface> surface = pEH->pBPlot->pPlotArea->surface;
+			pEH->pBPlot->reset( pEH->pBPlot->config );
+			TS_ASSERT_EQUALS( surface, pEH->pBPlot->pPlotArea->surface );
+		}
+
 };
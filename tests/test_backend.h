@@ -21,6 +21,9 @@
 	 -------------------------------------------------------------------
 	 */
 #include <cxxtest/TestSuite.h>
+#include <fstream>
+#include <cstdio>
+#include <sys/stat.h>
 
 #include "testhelpers.h"
 
@@ -64,6 +67,67 @@ class TestBackend : public CxxTest::TestSuite
 			TS_ASSERT( check_plot( "empty_plot" ) );
 		}
 
+		void testFrameSink() {
+			std::string path = "tests/tmp_plots/test_frames.y4m";
+			conf.frame_sink = path;
+			conf.frame_rate = 100;
+			{
+				BackendPlot bpl( conf, boost::shared_ptr<EventHandler>() );
+				TS_ASSERT( bpl.config.display );
+				bpl.point( 1, 1 );
+				bpl.display();
+			}
+			// Frames are 80x80, so 3*80*80 bytes each
+			std::ifstream file( path.c_str(), std::ios::binary );
+			std::string header;
+			std::getline( file, header );
+			TS_ASSERT_EQUALS( header.substr( 0, 18 ), "YUV4MPEG2 W80 H80 " );
+			std::getline( file, header );
+			TS_ASSERT_EQUALS( header, "FRAME" );
+			std::vector<char> frame( 3*80*80 );
+			file.read( &frame[0], frame.size() );
+			TS_ASSERT( file );
+			// Top left corner is white
+			TS_ASSERT_EQUALS( (unsigned char) frame[0], 235 );
+			TS_ASSERT_EQUALS( (unsigned char) frame[80*80], 128 );
+		}
+
+		void testFrameSinkFifoWithoutReader() {
+			std::string path = "tests/tmp_plots/test_frames.fifo";
+			remove( path.c_str() );
+			TS_ASSERT_EQUALS( mkfifo( path.c_str(), 0600 ), 0 );
+			conf.frame_sink = path;
+			conf.frame_rate = 100;
+			{
+				BackendPlot bpl( conf, boost::shared_ptr<EventHandler>() );
+				bpl.point( 1, 1 );
+				bpl.display();
+			}
+			// Getting here means closing did not wait for a reader
+			remove( path.c_str() );
+		}
+
+		void testSaveAsync() {
+			std::string path = "tests/tmp_plots/test_save_async.png";
+			conf.png_compression_level = 1;
+			size_t no_saved = 0;
+			{
+				BackendPlot bpl( conf, boost::shared_ptr<EventHandler>() );
+				bpl.point( 1, 1 );
+				bpl.save_async( path, [&]( const std::string &fn, bool success ) {
+						TS_ASSERT_EQUALS( fn, path );
+						TS_ASSERT( success );
+						++no_saved;
+						} );
+			}
+			// Destroying the plot waits for the writer
+			TS_ASSERT_EQUALS( no_saved, 1 );
+			std::ifstream file( path.c_str(), std::ios::binary );
+			std::string magic( 4, ' ' );
+			file.read( &magic[0], 4 );
+			TS_ASSERT_EQUALS( magic, "\x89PNG" );
+		}
+
 		void testRangeChecking() {
 			BackendPlot bpl = BackendPlot( conf, boost::shared_ptr<EventHandler>()  );
 			PlotConfig conf2 = PlotConfig();
@@ -387,6 +451,92 @@ class TestBackend : public CxxTest::TestSuite
 			TS_ASSERT( check_plot( "bh_adjust_data3" ) );
 		}
 
+		void testHistogramSeries() {
+			conf.fixed_plot_area = true;
+			BackendHistogram bh = BackendHistogram( conf, false, 2,
+					boost::shared_ptr<EventHandler>() );
+			bh.add_data( -1 );
+			bh.add_data( 1, 2 );
+			bh.add_data( 2, 2 );
+			bh.add_data( -2, 1 );
+			TS_ASSERT_EQUALS( bh.no_series, 3 );
+			TS_ASSERT_EQUALS( bh.series_bins.size(), 6 );
+			TS_ASSERT_EQUALS( bh.bins_y[0], 2 );
+			TS_ASSERT_EQUALS( bh.bins_y[1], 2 );
+			TS_ASSERT_EQUALS( bh.series_bins[0], 1 );
+			TS_ASSERT_EQUALS( bh.series_bins[2], 1 );
+			TS_ASSERT_EQUALS( bh.series_bins[5], 2 );
+			TS_ASSERT_EQUALS( bh.series_size[2], 2 );
+
+			bh.rebin_data();
+			TS_ASSERT_EQUALS( bh.bins_y[1], 2 );
+			TS_ASSERT_EQUALS( bh.series_bins[4], 0 );
+			TS_ASSERT_EQUALS( bh.series_bins[5], 2 );
+
+			bh.plot();
+			TS_ASSERT_DELTA( bh.config.max_y, 2.4, 1e-4 );
+			bh.stacked = true;
+			bh.plot();
+		}
+
+		void testHistogramSlidingWindow() {
+			conf.fixed_plot_area = true;
+			BackendHistogram bh = BackendHistogram( conf, false, 2,
+					boost::shared_ptr<EventHandler>() );
+			bh.add_data( -1 );
+			bh.sliding_window( 4, 2, false );
+			TS_ASSERT( bh.windowed );
+			TS_ASSERT_EQUALS( bh.data.size(), 0 );
+			TS_ASSERT_EQUALS( bh.window.bins()[0], 1 );
+			bh.add_data( 1 );
+			bh.add_data( 1 );
+			bh.add_data( 1 );
+			bh.add_data( 1 );
+			TS_ASSERT_EQUALS( bh.window.bins()[0], 1 );
+			TS_ASSERT_EQUALS( bh.window.bins()[1], 4 );
+			// Plotting at the time of the next sample drops the first slice
+			bh.plot();
+			TS_ASSERT_EQUALS( bh.bins_y[0], 0 );
+			TS_ASSERT_EQUALS( bh.bins_y[1], 2 );
+			TS_ASSERT_DELTA( bh.config.max_y, 2.4, 1e-4 );
+			TS_ASSERT_DELTA( bh.config.min_x, -5, 1e-4 );
+			TS_ASSERT_DELTA( bh.config.max_x, 5, 1e-4 );
+		}
+
+		void testHistogramEmptyWindow() {
+			conf.fixed_plot_area = true;
+			BackendHistogram bh = BackendHistogram( conf, false, 2,
+					boost::shared_ptr<EventHandler>() );
+			bh.add_data( -1 );
+			bh.sliding_window( 0, 2, false );
+			TS_ASSERT( !bh.windowed );
+			bh.decaying_window( -1, 2, false );
+			TS_ASSERT( !bh.windowed );
+			bh.add_data( 1 );
+			TS_ASSERT_EQUALS( bh.data.size(), 2 );
+		}
+
+		void testHistogramDecayingWindowAdjust() {
+			conf.fixed_plot_area = false;
+			BackendHistogram bh = BackendHistogram( conf, true, 3,
+					boost::shared_ptr<EventHandler>() );
+			bh.add_data( -1 );
+			bh.add_data( 2 );
+			double min = bh.min();
+			double max = bh.max();
+			bh.decaying_window( 2, 1, false );
+			TS_ASSERT( bh.config.fixed_plot_area );
+			TS_ASSERT_DELTA( bh.min(), min, 1e-4 );
+			TS_ASSERT_DELTA( bh.max(), max, 1e-4 );
+			TS_ASSERT_DELTA( bh.window.total(), 2, 1e-4 );
+			bh.add_data( 2 );
+			bh.add_data( 2 );
+			TS_ASSERT_DELTA( bh.window.total(), 4, 1e-4 );
+			// Half life passed
+			bh.add_data( 2 );
+			TS_ASSERT_DELTA( bh.window.total(), 3, 1e-4 );
+		}
+
 		/*
 		 * Histogram3d
 		 */
@@ -473,78 +623,119 @@ class TestBackend : public CxxTest::TestSuite
 			TS_ASSERT( check_plot( "bhm_3points_rescale" ) );
 		}
 
+		void testHeightMapSlidingWindow() {
+			conf.area = 60*60;
+			BackendHeightMap bhm = BackendHeightMap( conf, 
+					boost::shared_ptr<EventHandler>() );
+			bhm.sliding_window( 3, 0 );
+			bhm.add_data( -4,-4,5, true );
+			bhm.add_data( 0,1,0, true );
+			bhm.add_data( 1,0,1, true );
+			bhm.add_data( 1,1,2, true );
+			// The first point expired, and with it the highest value
+			TS_ASSERT_EQUALS( bhm.zmin, 0 );
+			TS_ASSERT_EQUALS( bhm.zmax, 2 );
+			// Its triangle lay outside of the new hull and has been cleared
+			Cairo::RefPtr<Cairo::ImageSurface> surface = bhm.pPlotArea->surface;
+			surface->flush();
+			double x = -3; double y = -3;
+			bhm.pPlotArea->transform_to_plot_units();
+			bhm.pPlotArea->context->user_to_device( x, y );
+			const uint32_t *row = (const uint32_t *) (surface->get_data() + 
+					((int) y)*surface->get_stride());
+			TS_ASSERT_EQUALS( row[(int) x], 0xffffffff );
+		}
+
+		void testHeightMapHiddenData() {
+			conf.area = 60*60;
+			BackendHeightMap bhm = BackendHeightMap( conf, 
+					boost::shared_ptr<EventHandler>() );
+			bhm.add_data( -4,-4,0, false );
+			bhm.add_data( -2,-4,1, false );
+			bhm.add_data( -4,-2,2, false );
+			TS_ASSERT( bhm.needs_full_redraw );
+			// Far away from the hidden points
+			bhm.add_data( 4,4,3, true );
+			TS_ASSERT( !bhm.needs_full_redraw );
+			// The hidden triangle has been drawn as well
+			Cairo::RefPtr<Cairo::ImageSurface> surface = bhm.pPlotArea->surface;
+			surface->flush();
+			double x = -3.5; double y = -3.5;
+			bhm.pPlotArea->transform_to_plot_units();
+			bhm.pPlotArea->context->user_to_device( x, y );
+			const uint32_t *row = (const uint32_t *) (surface->get_data() + 
+					((int) y)*surface->get_stride());
+			TS_ASSERT_DIFFERS( row[(int) x], 0xffffffff );
+		}
+
+		void testHeightMapHiddenSetData() {
+			conf.area = 60*60;
+			BackendHeightMap bhm = BackendHeightMap( conf, 
+					boost::shared_ptr<EventHandler>() );
+			std::vector<float> xs = { -4, -2, -4 };
+			std::vector<float> ys = { -4, -4, -2 };
+			std::vector<float> zs = { 0, 1, 2 };
+			bhm.set_data( xs, ys, zs, false );
+			TS_ASSERT( bhm.needs_full_redraw );
+			bhm.add_data( 4,4,1, true );
+			TS_ASSERT( !bhm.needs_full_redraw );
+			Cairo::RefPtr<Cairo::ImageSurface> surface = bhm.pPlotArea->surface;
+			surface->flush();
+			double x = -3.5; double y = -3.5;
+			bhm.pPlotArea->transform_to_plot_units();
+			bhm.pPlotArea->context->user_to_device( x, y );
+			const uint32_t *row = (const uint32_t *) (surface->get_data() + 
+					((int) y)*surface->get_stride());
+			TS_ASSERT_DIFFERS( row[(int) x], 0xffffffff );
+		}
+
+
+		void testGridHeightMapSnap() {
+			conf.min_x = 0; conf.max_x = 1;
+			conf.min_y = 0; conf.max_y = 2;
+			BackendGridHeightMap bghm = BackendGridHeightMap( conf, 
+					boost::shared_ptr<EventHandler>(), 11, 5 );
+			TS_ASSERT_EQUALS( bghm.zs.size(), 55 );
+			bghm.add_data( 0.29, 1.1, 3, false );
+			TS_ASSERT_EQUALS( bghm.zs[3*5+2], 3 );
+			bghm.add_data( 1, 2, 4, false );
+			TS_ASSERT_EQUALS( bghm.zs[54], 4 );
+			// Outside of the lattice
+			bghm.add_data( 1.2, 2, 5, false );
+			TS_ASSERT_EQUALS( bghm.zs[54], 4 );
+		}
 
-		void testVertex3DCrossProduct() {
-			boost::shared_ptr<Vertex3D> pV1( new Vertex3D( 1,0,0 ) );
-			boost::shared_ptr<Vertex3D> pV2( new Vertex3D( 0,1,0 ) );
-			boost::shared_ptr<Vertex3D> pV3 = pV1->crossProduct( pV2 );
-			TS_ASSERT_EQUALS( pV3->x, 0 );
-			TS_ASSERT_EQUALS( pV3->y, 0 );
-			TS_ASSERT_EQUALS( pV3->z, 1 );
-		}
-
-		void testTriangle3DgradientVector() {
-			boost::shared_ptr<Vertex3D> pV1( new Vertex3D( 1,0,0 ) );
-			boost::shared_ptr<Vertex3D> pV2( new Vertex3D( 0,1,0 ) );
-			boost::shared_ptr<Vertex3D> pV3( new Vertex3D( 1,1,1 ) );
-
-			Triangle3D tr = Triangle3D();
-			tr.vertices.push_back( pV1 );
-			tr.vertices.push_back( pV2 );
-			tr.vertices.push_back( pV3 );
-			std::vector<boost::shared_ptr<Vertex3D> > v;
-			v = tr.gradientVector();
-			TS_ASSERT_EQUALS( v[0]->x, 1 );
-			TS_ASSERT_EQUALS( v[0]->y, 0 );
-			TS_ASSERT_EQUALS( v[0]->z, 0 );
-			TS_ASSERT_EQUALS( v[1]->x, 1.5 );
-			TS_ASSERT_EQUALS( v[1]->y, 0.5 );
-			TS_ASSERT_EQUALS( v[1]->z, 1 );
-
-			Triangle3D tr2 = Triangle3D();
-			tr2.vertices.push_back( pV3 );
-			tr2.vertices.push_back( pV1 );
-			tr2.vertices.push_back( pV2 );
-			v = tr2.gradientVector();
-			TS_ASSERT_EQUALS( v[0]->x, 1 );
-			TS_ASSERT_EQUALS( v[0]->y, 0 );
-			TS_ASSERT_EQUALS( v[0]->z, 0 );
-			TS_ASSERT_EQUALS( v[1]->x, 1.5 );
-			TS_ASSERT_EQUALS( v[1]->y, 0.5 );
-			TS_ASSERT_EQUALS( v[1]->z, 1 );
-
-			pV1.reset( new Vertex3D( 0,0.5,0 ) );
-			pV2.reset( new Vertex3D( 0.5,0.5,0 ) );
-			pV3.reset( new Vertex3D( 0,1,0.25 ) );
-
-			Triangle3D tr3 = Triangle3D();
-			tr3.vertices.push_back( pV1 );
-			tr3.vertices.push_back( pV2 );
-			tr3.vertices.push_back( pV3 );
-			v = tr3.gradientVector();
-			TS_ASSERT_EQUALS( v[0]->x, 0 );
-			TS_ASSERT_EQUALS( v[0]->y, 0.5 );
-			TS_ASSERT_EQUALS( v[0]->z, 0 );
-			TS_ASSERT_EQUALS( v[1]->x, 0 );
-			TS_ASSERT_EQUALS( v[1]->y, 1 );
-			TS_ASSERT_EQUALS( v[1]->z, 0.25 );
-			pV1.reset( new Vertex3D( 0,0.5,0 ) );
-			pV2.reset( new Vertex3D( 0.5,0.5,0 ) );
-			pV3.reset( new Vertex3D( 0,1,0.25 ) );
-
-
-			// All zs are equal
-			pV1.reset( new Vertex3D( 0,0.5,1 ) );
-			pV2.reset( new Vertex3D( 0.5,0.5,1 ) );
-			pV3.reset( new Vertex3D( 0,1,1 ) );
-
-			Triangle3D tr4 = Triangle3D();
-			tr4.vertices.push_back( pV1 );
-			tr4.vertices.push_back( pV2 );
-			tr4.vertices.push_back( pV3 );
-			v = tr4.gradientVector();
-			TS_ASSERT_EQUALS( v[0]->z, 0 );
-			TS_ASSERT_EQUALS( v[1]->z, 0 );
+		void testGridHeightMapHiddenData() {
+			conf.min_x = 0; conf.max_x = 1;
+			conf.min_y = 0; conf.max_y = 2;
+			BackendGridHeightMap bghm = BackendGridHeightMap( conf, 
+					boost::shared_ptr<EventHandler>(), 11, 5 );
+			bghm.add_data( 0, 0, 0, true );
+			bghm.add_data( 0, 2, 10, true );
+			Cairo::RefPtr<Cairo::ImageSurface> surface = bghm.pPlotArea->surface;
+			double x = 0.95; double y = 0.05;
+			bghm.pPlotArea->transform_to_plot_units();
+			bghm.pPlotArea->context->user_to_device( x, y );
+			surface->flush();
+			const uint32_t *row = (const uint32_t *) (surface->get_data() + 
+					((int) y)*surface->get_stride());
+			uint32_t before = row[(int) x];
+
+			// Within the range of heights, so only its cells are dirty
+			bghm.add_data( 1, 0, 10, false );
+			TS_ASSERT( !bghm.needs_full_redraw );
+			TS_ASSERT_EQUALS( bghm.dirty_last_x, 10 );
+			// Far away from the hidden node
+			bghm.add_data( 0, 2, 5, true );
+			TS_ASSERT_LESS_THAN( bghm.dirty_last_x, bghm.dirty_first_x );
+			surface->flush();
+			TS_ASSERT_DIFFERS( row[(int) x], before );
+
+			// Outside of the range of heights
+			bghm.add_data( 0.5, 1, 20, false );
+			TS_ASSERT( bghm.needs_full_redraw );
+			bghm.add_data( 0, 2, 5, true );
+			TS_ASSERT( !bghm.needs_full_redraw );
 		}
 };
 	
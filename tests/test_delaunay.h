@@ -21,6 +21,7 @@
 	 -------------------------------------------------------------------
 	 */
 #include <cxxtest/TestSuite.h>
+#include <algorithm>
 
 #include "realtimeplot/delaunay.h"
 
@@ -54,116 +55,108 @@ class TestDelaunay : public CxxTest::TestSuite
 		}
 
 		void testEdge() {
-			boost::shared_ptr<Vertex> pV0( new Vertex(0,1));
-			boost::shared_ptr<Vertex> pV1( new Vertex(2,2));
-			Edge e = Edge( pV0, pV1 );
-			TS_ASSERT_EQUALS( (*e.pV0.get()), Vertex( 0,1 ) );
-			TS_ASSERT_EQUALS( (*e.pV1.get()), Vertex( 2,2 ) );
-			e = Edge( pV1, pV0 );
-			TS_ASSERT_EQUALS( (*e.pV0.get()), Vertex( 0,1 ) );
-			TS_ASSERT_EQUALS( (*e.pV1.get()), Vertex( 2,2 ) );
+			Edge e = Edge( Vertex(0,1), Vertex(2,2) );
+			TS_ASSERT_EQUALS( e.v0, Vertex( 0,1 ) );
+			TS_ASSERT_EQUALS( e.v1, Vertex( 2,2 ) );
+			e = Edge( Vertex(2,2), Vertex(0,1) );
+			TS_ASSERT_EQUALS( e.v0, Vertex( 0,1 ) );
+			TS_ASSERT_EQUALS( e.v1, Vertex( 2,2 ) );
 		}
 
 		void testEdgeIntersect() {
-			Edge e1 = Edge( boost::shared_ptr<Vertex>( new Vertex( 0,0 ) ),
-				boost::shared_ptr<Vertex>( new Vertex( 1,1 ) ) );
-			Edge e2 = Edge( boost::shared_ptr<Vertex>( new Vertex( 0,1 ) ),
-				boost::shared_ptr<Vertex>( new Vertex( 1,0 ) ) );
-			Edge e3 = Edge( boost::shared_ptr<Vertex>( new Vertex( 0,1 ) ),
-				boost::shared_ptr<Vertex>( new Vertex( 0.4,0.6 ) ) );
+			Edge e1 = Edge( Vertex( 0,0 ), Vertex( 1,1 ) );
+			Edge e2 = Edge( Vertex( 0,1 ), Vertex( 1,0 ) );
+			Edge e3 = Edge( Vertex( 0,1 ), Vertex( 0.4,0.6 ) );
 			TS_ASSERT( e1.intersect( e2 ) );
 			TS_ASSERT( !e1.intersect( e3 ) );
 		}
 
 
 		void testTriangleVertexInTriangle() {
-			boost::shared_ptr<Corner> c1( new Corner );
-			boost::shared_ptr<Corner> c2( new Corner );
-			boost::shared_ptr<Corner> c3( new Corner );
-			c1->vertex = boost::shared_ptr<Vertex>( new Vertex( 0,0 ) );
-			c2->vertex = boost::shared_ptr<Vertex>( new Vertex( 0,1 ) );
-			c3->vertex = boost::shared_ptr<Vertex>( new Vertex( 1,0 ) );
-
-			Triangle tr = Triangle();
-			tr.corners.push_back( c1 );
-			tr.corners.push_back( c2 );
-			tr.corners.push_back( c3 );
-
-			TS_ASSERT( tr.inTriangle( boost::shared_ptr<Vertex>( new Vertex( 0.4, 0.4 ) ) ) );
-			TS_ASSERT( !tr.inTriangle( boost::shared_ptr<Vertex>( new Vertex( 1, 1 ) ) ));
+			Triangle tr = Triangle( Vertex( 0,0 ), Vertex( 0,1 ), Vertex( 1,0 ) );
+
+			TS_ASSERT( tr.inTriangle( Vertex( 0.4, 0.4 ) ) );
+			TS_ASSERT( !tr.inTriangle( Vertex( 1, 1 ) ) );
 		}
 
 		void testTriangleInCircumCircle() {
 			//Not a very thorough test
+			Triangle tr = Triangle( Vertex( 0,0 ), Vertex( 0,1 ), Vertex( 1,0 ) );
 
-			boost::shared_ptr<Corner> c1( new Corner );
-			boost::shared_ptr<Corner> c2( new Corner );
-			boost::shared_ptr<Corner> c3( new Corner );
-			c1->vertex = boost::shared_ptr<Vertex>( new Vertex( 0,0 ) );
-			c2->vertex = boost::shared_ptr<Vertex>( new Vertex( 0,1 ) );
-			c3->vertex = boost::shared_ptr<Vertex>( new Vertex( 1,0 ) );
-
-			Triangle tr = Triangle();
-			tr.corners.push_back( c1 );
-			tr.corners.push_back( c2 );
-			tr.corners.push_back( c3 );
-
-			TS_ASSERT( 
-					tr.inCircumCircle( boost::shared_ptr<Vertex>( new Vertex( 0.4, 0.4 ) ) ) );
-			TS_ASSERT( 
-					!tr.inCircumCircle( boost::shared_ptr<Vertex>( new Vertex( 1.1, 1.1 ) ) ));
+			TS_ASSERT( tr.inCircumCircle( Vertex( 0.4, 0.4 ) ) );
+			TS_ASSERT( !tr.inCircumCircle( Vertex( 1.1, 1.1 ) ) );
 		}
 
-		// Used to check consistency of Delaunay state
-		void checkTriangleConsistency( boost::shared_ptr<Triangle> tr ) {
-			TS_ASSERT_EQUALS( tr->corners[0]->next, tr->corners[1] )
-			TS_ASSERT_EQUALS( tr->corners[1]->next, tr->corners[2] )
-			TS_ASSERT_EQUALS( tr->corners[2]->next, tr->corners[0] )
-			TS_ASSERT_EQUALS( tr->corners[0], tr->corners[1]->previous )
-			TS_ASSERT_EQUALS( tr->corners[1], tr->corners[2]->previous )
-			TS_ASSERT_EQUALS( tr->corners[2], tr->corners[0]->previous )
-			TS_ASSERT_EQUALS( tr->corners[0]->triangle, tr )
-			TS_ASSERT_EQUALS( tr->corners[1]->triangle, tr )
-			TS_ASSERT_EQUALS( tr->corners[2]->triangle, tr )
+		void testCornerNavigation() {
+			TS_ASSERT_EQUALS( Delaunay::next( 3 ), 4 );
+			TS_ASSERT_EQUALS( Delaunay::next( 5 ), 3 );
+			TS_ASSERT_EQUALS( Delaunay::previous( 3 ), 5 );
+			TS_ASSERT_EQUALS( Delaunay::previous( 4 ), 3 );
+			TS_ASSERT_EQUALS( Delaunay::triangle( 5 ), 1 );
+			TS_ASSERT_EQUALS( Delaunay::triangle( 6 ), 2 );
 		}
 
-		void checkOppositesConsistency( boost::shared_ptr<Corner> pC ) {
-			TS_ASSERT_EQUALS( pC->previous->vertex, pC->opposite->next->vertex )
-			TS_ASSERT_EQUALS( pC->next->vertex, pC->opposite->previous->vertex )
+		// Used to check consistency of Delaunay state
+		void checkOppositesConsistency( Delaunay &d, uint32_t c ) {
+			uint32_t o = d.opposites[c];
+			TS_ASSERT_EQUALS( d.opposites[o], c )
+			TS_ASSERT_EQUALS( d.corners[Delaunay::previous(c)], 
+					d.corners[Delaunay::next(o)] )
+			TS_ASSERT_EQUALS( d.corners[Delaunay::next(c)], 
+					d.corners[Delaunay::previous(o)] )
 		}
 
 		void checkDelaunayConsistency( Delaunay &d ) {
 			//Should start with some general stats like number of vertices etc
-			TS_ASSERT_EQUALS( d.triangles.size(), 2*d.vertices.size() - 2 - 3  );
-			TS_ASSERT_EQUALS( d.corners.size(), d.triangles.size()*3);
-
-			if (d.triangles.size()>1) {
-				std::map<boost::shared_ptr<Vertex>, size_t> no_triangles_per_vertex;
-				std::map<boost::shared_ptr<Vertex>, size_t>::iterator ntpv_iter;
-				for (size_t i=0; i<d.vertices.size(); ++i) {
-					no_triangles_per_vertex[d.vertices[i]] = 0;
-				}
+			size_t no_triangles = d.noTriangles() - d.freeTriangles.size();
+			TS_ASSERT_EQUALS( no_triangles, 2*d.noVertices() - 2 - 3  );
+			TS_ASSERT_EQUALS( d.corners.size(), d.noTriangles()*3 );
+			TS_ASSERT_EQUALS( d.opposites.size(), d.corners.size() );
+
+			std::vector<bool> free_vertex( d.vertices.size(), false );
+			for (auto & v : d.freeVertices)
+				free_vertex[v] = true;
+			for (auto & t : d.freeTriangles)
+				TS_ASSERT( d.isDeleted( t ) );
+
+			if (no_triangles>1) {
+				std::vector<size_t> no_triangles_per_vertex( d.vertices.size() );
 				for (size_t i=0; i<d.corners.size(); ++i) {
-					++no_triangles_per_vertex[d.corners[i]->vertex];
+					if (d.isDeleted( Delaunay::triangle( i ) ))
+						continue;
+					TS_ASSERT( d.corners[i] < d.vertices.size() );
+					TS_ASSERT( !free_vertex[d.corners[i]] );
+					++no_triangles_per_vertex[d.corners[i]];
 				}
-				for (ntpv_iter = no_triangles_per_vertex.begin(); 
-						ntpv_iter != no_triangles_per_vertex.end(); ++ntpv_iter) {
-					TS_ASSERT( ntpv_iter->second > 1 );
+				for (size_t i=0; i<no_triangles_per_vertex.size(); ++i) {
+					if (!free_vertex[i])
+						TS_ASSERT( no_triangles_per_vertex[i] > 1 );
 				}
 			}
 
-			// Triangles/next/previous
-			for (size_t i=0; i<d.triangles.size(); ++i) {
-				checkTriangleConsistency( d.triangles[i] );
+			// All triangles counterclockwise
+			for (size_t i=0; i<d.noTriangles(); ++i) {
+				if (!d.isDeleted( i ))
+					TS_ASSERT( orient2d( d.vertex( 3*i ), d.vertex( 3*i+1 ), 
+								d.vertex( 3*i+2 ) ) > 0 );
+			}
+
+			// Delaunay: no opposite vertex inside a circumcircle
+			for (size_t i=0; i<d.corners.size(); ++i) {
+				if (d.opposites[i] != noCorner)
+					TS_ASSERT( !d.getTriangle( Delaunay::triangle( i ) ).inCircumCircle( 
+								d.vertex( d.opposites[i] ) ) );
 			}
 
 			// Opposites
 			size_t lacking_opposites = 0;
 			for (size_t i=0; i<d.corners.size(); ++i) {
-				if (!d.corners[i]->opposite)
+				if (d.isDeleted( Delaunay::triangle( i ) ))
+					continue;
+				if (d.opposites[i] == noCorner)
 					++lacking_opposites;
 				else
-					checkOppositesConsistency( d.corners[i] );
+					checkOppositesConsistency( d, i );
 			}
 			TS_ASSERT_EQUALS( lacking_opposites, 3 );
 		}
@@ -171,18 +164,14 @@ class TestDelaunay : public CxxTest::TestSuite
 		void testDelaunaySetup()
 		{
 			Delaunay d = Delaunay( 0,1, 0,1 );
-			TS_ASSERT_EQUALS( d.triangles.size(), 1 );
+			TS_ASSERT_EQUALS( d.noTriangles(), 1 );
 			TS_ASSERT_EQUALS( d.vertices.size(), 3 );
 			TS_ASSERT_EQUALS( d.corners.size(), 3 );
 			
-			TS_ASSERT_EQUALS( d.corners[0]->triangle, d.triangles[0] );
-			TS_ASSERT_EQUALS( d.corners[0]->vertex, d.vertices[0] );
-			TS_ASSERT_EQUALS( d.triangles[0]->corners[1], d.corners[1] );
-
-			TS_ASSERT_EQUALS( d.corners[0]->next, d.corners[1] );
-			TS_ASSERT_EQUALS( d.corners[0]->previous, d.corners[2] );
-			TS_ASSERT_EQUALS( d.corners[1]->next, d.corners[2] );
-			TS_ASSERT_EQUALS( d.corners[1]->previous, d.corners[0] );
+			TS_ASSERT_EQUALS( d.corners[0], 0 );
+			TS_ASSERT_EQUALS( d.corners[1], 1 );
+			TS_ASSERT_EQUALS( d.corners[2], 2 );
+			TS_ASSERT_EQUALS( d.vertex( 1 ), d.vertices[1] );
 
 			checkDelaunayConsistency( d );
 			
@@ -191,49 +180,46 @@ class TestDelaunay : public CxxTest::TestSuite
 		void testDelaunayAddData() {
 			Delaunay d = Delaunay( 0,10, 0,50 );
 			checkDelaunayConsistency( d );
-			boost::shared_ptr<Vertex> vertex( new Vertex( 6.7215, 19.7191 ) );
-			boost::shared_ptr<Triangle> triangle =
-				d.findTriangle( vertex, d.triangles[0] );
-			TS_ASSERT( triangle->inTriangle( vertex ) );
+			Vertex vertex = Vertex( 6.7215, 19.7191 );
+			uint32_t triangle = d.findTriangle( vertex, 0 );
+			TS_ASSERT( d.getTriangle( triangle ).inTriangle( vertex ) );
 			checkDelaunayConsistency( d );
-			d.createNewTriangles( vertex, triangle );
+			TS_ASSERT_EQUALS( d.createNewTriangles( vertex, triangle ), 3 );
 			checkDelaunayConsistency( d );
-			vertex.reset( new Vertex( 3.20183, 44.5765 ) );
-			triangle =
-				d.findTriangle( vertex, d.triangles[0] );
-			TS_ASSERT( triangle->inTriangle( vertex ) );
+			vertex = Vertex( 3.20183, 44.5765 );
+			triangle = d.findTriangle( vertex, 0 );
+			TS_ASSERT( d.getTriangle( triangle ).inTriangle( vertex ) );
 			checkDelaunayConsistency( d );
-			d.createNewTriangles( vertex, triangle );
+			TS_ASSERT_EQUALS( d.createNewTriangles( vertex, triangle ), 4 );
 			checkDelaunayConsistency( d );
 	}
 
 		void testDelaunayFindTriangleFirstPoint()
 		{
 			Delaunay d = Delaunay( 0,1, 0,1 );
-			boost::shared_ptr<Vertex> v( new Vertex( 0.5, 0.4 ) );
-			TS_ASSERT_EQUALS( d.findTriangle( v, d.triangles[0] ), d.triangles[0] );
+			Vertex v = Vertex( 0.5, 0.4 );
+			TS_ASSERT_EQUALS( d.findTriangle( v, 0 ), 0 );
 			checkDelaunayConsistency( d );
 
 			Delaunay d2 = Delaunay( 0,10, 0,50 );
 			checkDelaunayConsistency( d2 );
-			boost::shared_ptr<Vertex> pV0( new Vertex( 5.1, 20 ) );
-			d2.add_data( pV0 );
+			d2.add_data( Vertex( 5.1, 20 ) );
 			checkDelaunayConsistency( d2 );
-			boost::shared_ptr<Vertex> pV1( new Vertex( 9.1, 2.2 ) );
-			TS_ASSERT( d2.findTriangle(pV1, d2.triangles[0])->inTriangle( pV1 ) );
-			d2.add_data( pV1 );
-			boost::shared_ptr<Vertex> pV2( new Vertex( 5, 15 ) );
-			TS_ASSERT( d2.findTriangle(pV2, d2.triangles[0])->inTriangle( pV2 ) );
-			d2.add_data( pV2 );
+			Vertex v1 = Vertex( 9.1, 2.2 );
+			TS_ASSERT( d2.getTriangle( d2.findTriangle( v1, 0 ) ).inTriangle( v1 ) );
+			d2.add_data( v1 );
+			Vertex v2 = Vertex( 5, 15 );
+			TS_ASSERT( d2.getTriangle( d2.findTriangle( v2, 0 ) ).inTriangle( v2 ) );
+			d2.add_data( v2 );
 			checkDelaunayConsistency( d2 );
 		}
 
 		void testDelaunayCreateNewTriangles()
 		{
 			Delaunay d = Delaunay( 0,1, 0,1 );
-			boost::shared_ptr<Vertex> pVertex( new Vertex( 0.5, 0.4 ) );
-			d.createNewTriangles( pVertex, d.findTriangle( pVertex, d.triangles[0] ) );
-			TS_ASSERT_EQUALS( d.triangles.size(), 3 );
+			Vertex vertex = Vertex( 0.5, 0.4 );
+			d.createNewTriangles( vertex, d.findTriangle( vertex, 0 ) );
+			TS_ASSERT_EQUALS( d.noTriangles(), 3 );
 			TS_ASSERT_EQUALS( d.vertices.size(), 4 );
 			TS_ASSERT_EQUALS( d.corners.size(), 9 );
 			checkDelaunayConsistency( d );
@@ -242,35 +228,271 @@ class TestDelaunay : public CxxTest::TestSuite
 		void testSquareLattice()
 		{
 			Delaunay d = Delaunay( 0,1, 0,1 );
-			for (size_t i=0; i<10; ++i) {
-				for (size_t j=0; j<10; ++j) {
-					float x = 1.0/10*i;
-					float y = 1.0/10*j;
-					boost::shared_ptr<Vertex> vertex( new Vertex( x, y ) );
-					boost::shared_ptr<Triangle> triangle =
-						d.findTriangle( vertex, d.triangles[0] );
+			for (size_t i=0; i<25; ++i) {
+				for (size_t j=0; j<25; ++j) {
+					float x = 1.0/25*i;
+					float y = 1.0/25*j;
+					Vertex vertex = Vertex( x, y );
+					uint32_t triangle = d.findTriangle( vertex, 0 );
 					checkDelaunayConsistency( d );
-					if (!triangle->inTriangle( vertex )) {
-						std::cout << (*triangle) << " " << (*vertex) << std::endl;
+					if (!d.getTriangle( triangle ).inTriangle( vertex )) {
+						std::cout << d.getTriangle( triangle ) << " " << vertex << std::endl;
 					}
-					TS_ASSERT( triangle->inTriangle( vertex ) );
+					TS_ASSERT( d.getTriangle( triangle ).inTriangle( vertex ) );
 					d.createNewTriangles( vertex, triangle );
 					checkDelaunayConsistency( d );
 				}
 			}
 		}
 
+		void testOrient2d() {
+			TS_ASSERT( orient2d( Vertex( 0,0 ), Vertex( 1,0 ), Vertex( 0,1 ) ) > 0 );
+			TS_ASSERT( orient2d( Vertex( 0,0 ), Vertex( 0,1 ), Vertex( 1,0 ) ) < 0 );
+			TS_ASSERT_EQUALS( orient2d( Vertex( 0,0 ), Vertex( 1,1 ), Vertex( 2,2 ) ), 0 );
+		}
+
+		void testOrient2dExact() {
+			// Collinear, but the differences are not exact in double
+			Vertex a = Vertex( 1e-10f, 1e-10f );
+			Vertex b = Vertex( 1e10f, 1e10f );
+			Vertex c = Vertex( 3.3f, 3.3f );
+			TS_ASSERT_EQUALS( orient2d( a, b, c ), 0 );
+			TS_ASSERT_EQUALS( orient2d( c, a, b ), 0 );
+			TS_ASSERT( orient2d( a, b, Vertex( 3.3f, 3.3000002f ) ) > 0 );
+		}
+
+		void testIncircle() {
+			Vertex a = Vertex( 0,0 );
+			Vertex b = Vertex( 1,0 );
+			Vertex c = Vertex( 0,1 );
+			TS_ASSERT( incircle( a, b, c, Vertex( 0.4, 0.4 ) ) > 0 );
+			TS_ASSERT( incircle( a, b, c, Vertex( 1.1, 1.1 ) ) < 0 );
+			// Cocircular
+			TS_ASSERT_EQUALS( incircle( a, b, c, Vertex( 1, 1 ) ), 0 );
+		}
+
+		void testDelaunayCollinear() {
+			Delaunay d = Delaunay( 0,1, 0,1 );
+			for (size_t i=0; i<20; ++i)
+				d.add_data( Vertex( 0.05*i, 0.5 ) );
+			d.add_data( Vertex( 0.5, 0.2 ) );
+			for (size_t i=0; i<20; ++i)
+				d.add_data( Vertex( 0.25, 0.05*i ) );
+			TS_ASSERT_EQUALS( d.vertices.size(), 3+20+1+19 );
+			checkDelaunayConsistency( d );
+		}
+
+		void testDelaunayDuplicateVertex() {
+			Delaunay d = Delaunay( 0,1, 0,1 );
+			TS_ASSERT_EQUALS( d.add_data( Vertex( 0.5, 0.5 ) ), 3 );
+			TS_ASSERT_EQUALS( d.add_data( Vertex( 0.2, 0.7 ) ), 4 );
+			TS_ASSERT_EQUALS( d.add_data( Vertex( 0.5, 0.5 ) ), 3 );
+			TS_ASSERT_EQUALS( d.vertices.size(), 5 );
+			checkDelaunayConsistency( d );
+		}
+
+		void testDelaunayFindTriangleSeeded() {
+			Delaunay d = Delaunay( 0,10, 0,50 );
+			for (size_t i=0; i<500; ++i) {
+				Vertex vertex = Vertex( 10*float(std::rand())/RAND_MAX,
+						50*float(std::rand())/RAND_MAX );
+				TS_ASSERT( d.getTriangle( d.findTriangle( vertex ) ).inTriangle( vertex ) );
+				d.add_data( vertex );
+			}
+			checkDelaunayConsistency( d );
+		}
+
+		void testHilbertIndex() {
+			// First level: quadrants visited in the order (0,0) (0,1) (1,1) (1,0)
+			uint64_t q = uint64_t(1) << 30;
+			TS_ASSERT_EQUALS( hilbertIndex( 0, 0 ), 0 );
+			TS_ASSERT_EQUALS( hilbertIndex( 0, 65535 )/q, 1 );
+			TS_ASSERT_EQUALS( hilbertIndex( 65535, 65535 )/q, 2 );
+			TS_ASSERT_EQUALS( hilbertIndex( 65535, 0 )/q, 3 );
+			TS_ASSERT_EQUALS( hilbertIndex( 65535, 0 ), 4*q-1 );
+		}
+
+		void testInsertionOrder() {
+			std::vector<Vertex> batch;
+			for (size_t i=0; i<1000; ++i)
+				batch.push_back( Vertex( float(std::rand())/RAND_MAX, 
+							float(std::rand())/RAND_MAX ) );
+			std::vector<uint32_t> order = insertionOrder( batch );
+			TS_ASSERT_EQUALS( order.size(), 1000 );
+			std::vector<bool> seen( 1000, false );
+			for (auto & i : order)
+				seen[i] = true;
+			TS_ASSERT_EQUALS( std::count( seen.begin(), seen.end(), true ), 1000 );
+		}
+
+		void testDelaunayAddBatch() {
+			Delaunay d = Delaunay( 0,10, 0,50 );
+			d.add_data( Vertex( 5, 5 ) );
+			std::vector<Vertex> batch;
+			for (size_t i=0; i<2000; ++i)
+				batch.push_back( Vertex( 10*float(std::rand())/RAND_MAX,
+							50*float(std::rand())/RAND_MAX ) );
+			batch.push_back( Vertex( 5, 5 ) );
+			std::vector<uint32_t> ids = d.add_data( batch );
+			TS_ASSERT_EQUALS( ids.size(), batch.size() );
+			for (size_t i=0; i<batch.size(); ++i)
+				TS_ASSERT_EQUALS( d.vertices[ids[i]], batch[i] );
+			TS_ASSERT_EQUALS( ids.back(), 3 );
+			checkDelaunayConsistency( d );
+		}
+
+		void testDelaunayTriangulate() {
+			std::vector<Vertex> points;
+			for (size_t i=0; i<20000; ++i)
+				points.push_back( Vertex( 10*float(std::rand())/RAND_MAX,
+							50*float(std::rand())/RAND_MAX ) );
+			points.push_back( points[5] );
+			for (size_t no_threads=1; no_threads<=4; no_threads *= 4) {
+				Delaunay d = Delaunay( 0,10, 0,50 );
+				std::vector<uint32_t> ids = d.triangulate( points, no_threads );
+				TS_ASSERT_EQUALS( ids.size(), points.size() );
+				for (size_t i=0; i<points.size(); ++i)
+					TS_ASSERT_EQUALS( d.vertices[ids[i]], points[i] );
+				TS_ASSERT_EQUALS( ids.back(), ids[5] );
+				TS_ASSERT_EQUALS( d.noVertices(), points.size()+2 );
+				checkDelaunayConsistency( d );
+				// Can be added to and removed from afterwards
+				d.add_data( Vertex( 5.5, 5.5 ) );
+				d.remove_data( ids[0] );
+				checkDelaunayConsistency( d );
+			}
+		}
+
+		void testDelaunayTriangulateLattice() {
+			std::vector<Vertex> points;
+			for (size_t i=0; i<=40; ++i) {
+				for (size_t j=0; j<=40; ++j)
+					points.push_back( Vertex( 0.25*i, 0.25*j ) );
+			}
+			Delaunay d = Delaunay( 0,10, 0,10 );
+			d.triangulate( points, 4 );
+			checkDelaunayConsistency( d );
+
+			// All on one line
+			points.clear();
+			for (size_t i=0; i<100; ++i)
+				points.push_back( Vertex( 0.1*i, 5 ) );
+			Delaunay d2 = Delaunay( 0,10, 0,10 );
+			d2.triangulate( points, 2 );
+			checkDelaunayConsistency( d2 );
+		}
+
+		void testContourSegment() {
+			Delaunay d = Delaunay( 0,10, 0,10 );
+			std::vector<float> heights( 3, 0 );
+			for (size_t i=0; i<200; ++i) {
+				Vertex v = Vertex( 10*float(std::rand())/RAND_MAX,
+						10*float(std::rand())/RAND_MAX );
+				uint32_t id = d.add_data( v );
+				heights.resize( d.vertices.size() );
+				heights[id] = v.x;
+			}
+			std::vector<Vertex> ends;
+			for (uint32_t t=0; t<d.noTriangles(); ++t) {
+				if (d.corners[3*t] < 3 || d.corners[3*t+1] < 3 || d.corners[3*t+2] < 3)
+					continue;
+				Vertex from, to;
+				if (d.contourSegment( t, heights, 5, from, to )) {
+					TS_ASSERT_DELTA( from.x, 5, 1e-4 );
+					TS_ASSERT_DELTA( to.x, 5, 1e-4 );
+					ends.push_back( from );
+					ends.push_back( to );
+				}
+			}
+			TS_ASSERT( ends.size() > 0 );
+			// Neighbours share their end points exactly, except at the convex hull
+			size_t no_unshared = 0;
+			for (auto & e : ends) {
+				if (std::count( ends.begin(), ends.end(), e ) == 1)
+					++no_unshared;
+			}
+			TS_ASSERT_EQUALS( no_unshared, 2 );
+		}
+
+		void testDelaunayChangedTriangles() {
+			Delaunay d = Delaunay( 0,10, 0,50 );
+			for (size_t i=0; i<50; ++i) {
+				d.changedTriangles.clear();
+				std::vector<Vertex> old_triangles;
+				for (size_t j=0; j<d.corners.size(); ++j)
+					old_triangles.push_back( d.vertex( j ) );
+				uint32_t v = d.add_data( Vertex( 10*float(std::rand())/RAND_MAX,
+							50*float(std::rand())/RAND_MAX ) );
+				std::vector<bool> changed( d.noTriangles(), false );
+				for (auto & t : d.changedTriangles)
+					changed[t] = true;
+				for (size_t t=0; t<d.noTriangles(); ++t) {
+					// Triangles using the new vertex changed
+					for (uint32_t c=3*t; c<3*t+3; ++c) {
+						if (d.corners[c] == v)
+							TS_ASSERT( changed[t] );
+					}
+					// Unchanged triangles are the same as before
+					if (!changed[t]) {
+						for (uint32_t c=3*t; c<3*t+3; ++c)
+							TS_ASSERT_EQUALS( d.vertex( c ), old_triangles[c] );
+					}
+				}
+			}
+		}
+
+		void testDelaunayRemove() {
+			Delaunay d = Delaunay( 0,10, 0,50 );
+			std::vector<uint32_t> ids;
+			for (size_t i=0; i<200; ++i)
+				ids.push_back( d.add_data( Vertex( 10*float(std::rand())/RAND_MAX,
+								50*float(std::rand())/RAND_MAX ) ) );
+			size_t no_slots = d.noTriangles();
+			for (size_t i=0; i<100; ++i) {
+				d.remove_data( ids[i] );
+				checkDelaunayConsistency( d );
+			}
+			TS_ASSERT_EQUALS( d.noVertices(), 103 );
+			TS_ASSERT_EQUALS( d.freeVertices.size(), 100 );
+			// Removing twice does nothing
+			d.remove_data( ids[0] );
+			TS_ASSERT_EQUALS( d.freeVertices.size(), 100 );
+			// Freed slots are reused
+			for (size_t i=0; i<100; ++i)
+				d.add_data( Vertex( 10*float(std::rand())/RAND_MAX,
+							50*float(std::rand())/RAND_MAX ) );
+			checkDelaunayConsistency( d );
+			TS_ASSERT_EQUALS( d.vertices.size(), 203 );
+			TS_ASSERT_EQUALS( d.noTriangles(), no_slots );
+		}
+
+		void testDelaunayRemoveLattice() {
+			// Many cocircular points
+			Delaunay d = Delaunay( 0,1, 0,1 );
+			std::vector<uint32_t> ids;
+			for (size_t i=0; i<10; ++i) {
+				for (size_t j=0; j<10; ++j)
+					ids.push_back( d.add_data( Vertex( 0.1*i, 0.1*j ) ) );
+			}
+			for (size_t i=0; i<ids.size(); i+=3) {
+				d.remove_data( ids[i] );
+				checkDelaunayConsistency( d );
+			}
+			for (size_t i=0; i<ids.size(); i+=3)
+				d.add_data( Vertex( 0.1*(i/10), 0.1*(i%10) ) );
+			checkDelaunayConsistency( d );
+		}
+
 		void testDelaunayManyTimes()
 		{
 			Delaunay d = Delaunay( 0,10, 0,50 );
 			for (size_t i=0; i<100; ++i) {
 				float x = 8*float(std::rand())/RAND_MAX;
 				float y = 50*float(std::rand())/RAND_MAX;
-				boost::shared_ptr<Vertex> vertex( new Vertex( x, y ) );
-				boost::shared_ptr<Triangle> triangle =
-					d.findTriangle( vertex, d.triangles[0] );
+				Vertex vertex = Vertex( x, y );
+				uint32_t triangle = d.findTriangle( vertex, 0 );
 				checkDelaunayConsistency( d );
-				TS_ASSERT( triangle->inTriangle( vertex ) );
+				TS_ASSERT( d.getTriangle( triangle ).inTriangle( vertex ) );
 				d.createNewTriangles( vertex, triangle );
 				checkDelaunayConsistency( d );
 			}
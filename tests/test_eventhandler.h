@@ -64,6 +64,32 @@ class TestEventHandler : public CxxTest::TestSuite
 			TS_ASSERT_EQUALS( pEventHandler->get_queue_size(), 0 );
   	}
 
+		void testPooledEventsAreExecuted() {
+			std::vector<boost::shared_ptr<EventHandler> > handlers;
+			std::vector<boost::shared_ptr<MockEvent> > events;
+			for (size_t i = 0; i < 10; ++i) {
+				boost::shared_ptr<EventHandler> pEventHandler(
+						new EventHandler( true ) );
+				TS_ASSERT( !pEventHandler->pEventProcessingThrd );
+				pEventHandler->add_event( boost::shared_ptr<Event>(
+							new OpenPlotEvent( conf, pEventHandler ) ) );
+				for (size_t j = 0; j < 3; ++j) {
+					boost::shared_ptr<MockEvent> e( new MockEvent() );
+					MOCK_EXPECT( e->execute ).exactly(1);
+					pEventHandler->add_event( boost::shared_ptr<Event>( e ) );
+					events.push_back( e );
+				}
+				pEventHandler->add_event( boost::shared_ptr<Event>(
+							new FinalEvent(pEventHandler, false ) ) );
+				handlers.push_back( pEventHandler );
+			}
+			for (auto & pEventHandler : handlers) {
+				pEventHandler->join();
+				TS_ASSERT_EQUALS( pEventHandler->get_queue_size(), 0 );
+				TS_ASSERT_EQUALS( pEventHandler->processing_events, false );
+			}
+		}
+
 		void testProcessingEventsSet() {
 			boost::shared_ptr<EventHandler> pEventHandler( 
 					new EventHandler() );
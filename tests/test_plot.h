@@ -46,6 +46,15 @@ class TestPlot : public CxxTest::TestSuite {
 			TS_ASSERT_EQUALS( c3, Color( 1, 1, 0, 1 ) );
 		}
 
+		void testColorARGB32() {
+			TS_ASSERT_EQUALS( Color::black().argb32(), 0xff000000 );
+			TS_ASSERT_EQUALS( Color::white().argb32(), 0xffffffff );
+			TS_ASSERT_EQUALS( Color( 1, 0, 0, 1 ).argb32(), 0xffff0000 );
+			// Premultiplied
+			TS_ASSERT_EQUALS( Color( 1, 1, 1, 0 ).argb32(), 0 );
+			TS_ASSERT_EQUALS( Color( 0, 0, 1, 0.2 ).argb32(), 0x33000033 );
+		}
+
 		void testColorMapScaling() {
 			ColorMap cm = ColorMap();
 			TS_ASSERT_EQUALS( cm.scale( 0.5 ), 0.5 );
@@ -60,6 +69,41 @@ class TestPlot : public CxxTest::TestSuite {
 			TS_ASSERT_DIFFERS( cm( 0.1 ), cms(0.1) );
 		}
 
+		void testColorMapLUT() {
+			ColorMap cm = ColorMap();
+			TS_ASSERT_EQUALS( cm.argb32( 0 ), 0xffffff00 );
+			TS_ASSERT_EQUALS( cm.argb32( 0.5 ), 0xffff0000 );
+			TS_ASSERT_EQUALS( cm.argb32( 1 ), 0xff000000 );
+			TS_ASSERT_EQUALS( cm.argb32( 2 ), 0xff000000 );
+			TS_ASSERT_EQUALS( cm.argb32( -1 ), 0xffffff00 );
+			TS_ASSERT_EQUALS( cm.argb32( 0.3 ), cm( 0.3 ).argb32() );
+			TS_ASSERT_DELTA( cm.lookup( 0.25 ).g, cm( 0.25 ).g, 1e-2 );
+
+			cm.calculate_height_scaling( 0.5, 0.01 );
+			TS_ASSERT_EQUALS( cm.argb32( 0.1 ), cm( 0.1 ).argb32() );
+			TS_ASSERT_EQUALS( cm.argb32( 0.8 ), cm( 0.8 ).argb32() );
+
+			std::vector<double> proportions;
+			proportions.push_back( 0 );
+			proportions.push_back( 0.8 );
+			std::vector<uint32_t> colors;
+			cm.argb32( proportions, colors );
+			TS_ASSERT_EQUALS( colors.size(), 2 );
+			TS_ASSERT_EQUALS( colors[1], cm.argb32( 0.8 ) );
+		}
+
+		void testColorMapPalette() {
+			ColorMap cm = ColorMap();
+			std::vector<Color> palette;
+			palette.push_back( Color::white() );
+			palette.push_back( Color::blue() );
+			cm.set_palette( palette );
+			TS_ASSERT_EQUALS( cm( 0 ), Color::white() );
+			TS_ASSERT_EQUALS( cm( 1 ), Color::blue() );
+			TS_ASSERT_EQUALS( cm( 0.5 ), Color( 0.5, 0.5, 1, 1 ) );
+			TS_ASSERT_EQUALS( cm.argb32( 1 ), Color::blue().argb32() );
+		}
+
 		void testResetAdaptive() {
 			PlotConfig conf = PlotConfig();
 			conf.display = false;
@@ -93,5 +137,18 @@ class TestPlot : public CxxTest::TestSuite {
 			TS_ASSERT_EQUALS( pAEH->adaptive, false );
 		}
 
+		void testPooledHeightMap() {
+			PlotConfig conf = PlotConfig();
+			conf.display = false;
+			conf.worker_pool = true;
+			conf.min_x = -1;
+			conf.max_x = 1;
+			HeightMap hm = HeightMap( conf );
+			TS_ASSERT( !hm.pEventHandler->pEventProcessingThrd );
+			TS_ASSERT_EQUALS( hm.config.fixed_plot_area, true );
+			TS_ASSERT_EQUALS( hm.config.min_x, -1 );
+			hm.add_data( 0, 0, 1 );
+		}
+
 };
 
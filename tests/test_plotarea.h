@@ -97,6 +97,84 @@ class TestPlotArea : public CxxTest::TestSuite
 			TS_ASSERT( check_plot( "draw_rectangle_unfill" ) );
 		}
 
+		void testImage() {
+			PlotArea pl_area = PlotArea( conf );
+			Cairo::RefPtr<Cairo::ImageSurface> image = 
+				Cairo::ImageSurface::create( Cairo::FORMAT_ARGB32, 2, 2 );
+			image->flush();
+			uint32_t *pixels = reinterpret_cast<uint32_t*>( image->get_data() );
+			size_t stride = image->get_stride()/4;
+			pixels[0] = 0xff0000ff; // top left, blue
+			pixels[1] = 0xff00ff00; // top right, green
+			pixels[stride] = 0xffff0000; // bottom left, red
+			pixels[stride+1] = 0xff000000;
+			image->mark_dirty();
+			pl_area.image( image, -4, -4, 8, 8 );
+			pl_area.surface->flush();
+
+			uint32_t *surface_pixels = 
+				reinterpret_cast<uint32_t*>( pl_area.surface->get_data() );
+			size_t surface_stride = pl_area.surface->get_stride()/4;
+			// Plot coordinates (-3,-3) lie at device coordinates (110, 140)
+			TS_ASSERT_EQUALS( surface_pixels[140*surface_stride+110], 0xffff0000 );
+			TS_ASSERT_EQUALS( surface_pixels[110*surface_stride+110], 0xff0000ff );
+			TS_ASSERT_EQUALS( surface_pixels[110*surface_stride+140], 0xff00ff00 );
+			TS_ASSERT_EQUALS( surface_pixels[140*surface_stride+140], 0xff000000 );
+			// Outside of the image
+			TS_ASSERT_EQUALS( surface_pixels[10*surface_stride+10], 0xffffffff );
+		}
+
+		void testTriangles() {
+			PlotArea pl_area = PlotArea( conf );
+			std::vector<delaunay::Vertex> vertices;
+			vertices.push_back( delaunay::Vertex( -4, -4 ) );
+			vertices.push_back( delaunay::Vertex( 4, -4 ) );
+			vertices.push_back( delaunay::Vertex( -4, 4 ) );
+			std::vector<float> values( 3, 0 );
+			values[1] = 1;
+			std::vector<uint32_t> indices;
+			indices.push_back( 0 );
+			indices.push_back( 1 );
+			indices.push_back( 2 );
+			std::vector<uint32_t> lut;
+			lut.push_back( 0xffff0000 );
+			lut.push_back( 0xff0000ff );
+			pl_area.triangles( vertices, values, 0, 1, indices, lut );
+			pl_area.surface->flush();
+
+			uint32_t *surface_pixels = 
+				reinterpret_cast<uint32_t*>( pl_area.surface->get_data() );
+			size_t surface_stride = pl_area.surface->get_stride()/4;
+			// Plot coordinates (-3,-3) lie at device coordinates (110, 140)
+			TS_ASSERT_EQUALS( surface_pixels[140*surface_stride+110], 0xffff0000 );
+			// (3,-3), close to vertex 1
+			TS_ASSERT_EQUALS( surface_pixels[140*surface_stride+140], 0xff0000ff );
+			// (3,3) is outside of the triangle
+			TS_ASSERT_EQUALS( surface_pixels[110*surface_stride+140], 0xffffffff );
+		}
+
+		void testBilinear() {
+			PlotArea pl_area = PlotArea( conf );
+			// 2x2 nodes, value 1 only at (4,-4)
+			std::vector<float> values( 4, 0 );
+			values[1*2+0] = 1;
+			std::vector<uint32_t> lut;
+			lut.push_back( 0xffff0000 );
+			lut.push_back( 0xff00ff00 );
+			lut.push_back( 0xff0000ff );
+			pl_area.bilinear( values, 2, 2, -4, -4, 8, 8, 0, 1, lut, 0, 1, 0, 1 );
+			pl_area.surface->flush();
+
+			uint32_t *surface_pixels = 
+				reinterpret_cast<uint32_t*>( pl_area.surface->get_data() );
+			size_t surface_stride = pl_area.surface->get_stride()/4;
+			// (-3,-3), (3,-3), (0,-4) and outside
+			TS_ASSERT_EQUALS( surface_pixels[140*surface_stride+110], 0xffff0000 );
+			TS_ASSERT_EQUALS( surface_pixels[140*surface_stride+140], 0xff0000ff );
+			TS_ASSERT_EQUALS( surface_pixels[144*surface_stride+125], 0xff00ff00 );
+			TS_ASSERT_EQUALS( surface_pixels[10*surface_stride+10], 0xffffffff );
+		}
+
 		void testClear() {
 			PlotArea pl_area = PlotArea( conf );
 			pl_area.surface->write_to_png( fn( "empty" ) );
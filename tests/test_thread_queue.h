@@ -211,6 +211,20 @@ class TestThreadQueue : public CxxTest::TestSuite {
 			TS_ASSERT_EQUALS( tq.pop(), 2 );
 		}
 
+		void testQ2TryPop() {
+			ThreadSplitQueue<size_t> tq = ThreadSplitQueue<size_t>( 100 );
+			size_t el = 5;
+			TS_ASSERT( !tq.try_pop( el ) );
+			TS_ASSERT_EQUALS( el, 5 );
+			tq.push( 0 );
+			tq.push( 1, true );
+			TS_ASSERT( tq.try_pop( el ) );
+			TS_ASSERT_EQUALS( el, 1 );
+			TS_ASSERT( tq.try_pop( el ) );
+			TS_ASSERT_EQUALS( el, 0 );
+			TS_ASSERT( !tq.try_pop( el ) );
+		}
+
 
 		void testQ2Write() { 
 			Q2ReaderWriter qrw = Q2ReaderWriter( 100 );
@@ -74,6 +74,66 @@ class TestUtils : public CxxTest::TestSuite {
 			TS_ASSERT_EQUALS( range.size(), 2 );
 		}
 
+		void testWindowedBinsSliding() {
+			WindowedBins window;
+			window.set_sliding( 3, 2, 2 );
+			window.add( 0, 0 );
+			window.add( 1, 1 );
+			TS_ASSERT_EQUALS( window.bins()[0], 1 );
+			TS_ASSERT_EQUALS( window.bins()[1], 1 );
+			TS_ASSERT_EQUALS( window.total(), 2 );
+			// Second slice, first one still in the window
+			window.add( 1, 2 );
+			window.add( 2, 3 );
+			TS_ASSERT_EQUALS( window.bins()[0], 1 );
+			TS_ASSERT_EQUALS( window.bins()[1], 2 );
+			TS_ASSERT_EQUALS( window.total(), 4 );
+			// First slice is dropped
+			window.add( 2, 4 );
+			TS_ASSERT_EQUALS( window.bins()[0], 0 );
+			TS_ASSERT_EQUALS( window.bins()[1], 1 );
+			TS_ASSERT_EQUALS( window.bins()[2], 2 );
+			TS_ASSERT_EQUALS( window.total(), 3 );
+			// Long gap empties the window
+			window.advance( 20 );
+			TS_ASSERT_EQUALS( window.bins()[1], 0 );
+			TS_ASSERT_EQUALS( window.bins()[2], 0 );
+			TS_ASSERT_EQUALS( window.total(), 0 );
+		}
+
+		void testWindowedBinsDecaying() {
+			WindowedBins window;
+			window.set_decaying( 2, 0.5, 1 );
+			window.add( 0, 0, 4 );
+			window.add( 1, 0.5, 2 );
+			TS_ASSERT_DELTA( window.bins()[0], 4, 1e-10 );
+			window.advance( 1 );
+			TS_ASSERT_DELTA( window.bins()[0], 2, 1e-10 );
+			TS_ASSERT_DELTA( window.bins()[1], 1, 1e-10 );
+			window.add( 1, 3.2 );
+			TS_ASSERT_DELTA( window.bins()[0], 0.5, 1e-10 );
+			TS_ASSERT_DELTA( window.bins()[1], 1.25, 1e-10 );
+			TS_ASSERT_DELTA( window.total(), 1.75, 1e-10 );
+		}
+
+		void testWindowedBinsResize() {
+			WindowedBins window;
+			window.set_sliding( 2, 2, 2 );
+			window.add( 1, 0 );
+			window.add( 0, 2 );
+			window.resize( 4 );
+			window.add( 3, 3 );
+			TS_ASSERT_EQUALS( window.bins().size(), 4 );
+			TS_ASSERT_EQUALS( window.bins()[1], 1 );
+			TS_ASSERT_EQUALS( window.total(), 3 );
+			// Counts of resized bins are still dropped with their slice
+			window.advance( 4 );
+			TS_ASSERT_EQUALS( window.bins()[0], 1 );
+			TS_ASSERT_EQUALS( window.bins()[1], 0 );
+			TS_ASSERT_EQUALS( window.bins()[3], 1 );
+			TS_ASSERT_EQUALS( window.total(), 2 );
+		}
+
 		void testStringify() {
 			TS_ASSERT_EQUALS( stringify( 1 ), "1" );
 			TS_ASSERT_EQUALS( stringify( 10 ), "10" );
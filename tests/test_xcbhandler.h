@@ -1,5 +1,7 @@
 #include <cxxtest/TestSuite.h>
 
+#include <cairomm/context.h>
+
 #include "realtimeplot/xcbhandler.h"
 
 using namespace realtimeplot;
@@ -24,5 +26,64 @@ class TestXcbHandler : public CxxTest::TestSuite
 			xcb->open_window(500,500);
 			//size_t win = xcb->open_window(500,500);
 		}
+
+		void testXcbBackBuffer() {
+			XcbHandler *xcb = static_cast<XcbHandler*>( XcbHandler::Instance() );
+			// The pixmap is only used without shared memory
+			bool shm_available = xcb->shm_available;
+			xcb->shm_available = false;
+			size_t win = xcb->open_window(100,50);
+			TS_ASSERT( !xcb->present_region( win, 0, 0, 100, 50 ) );
+			Cairo::RefPtr<Cairo::Surface> surface = xcb->get_cairo_surface( win, 100, 50 );
+			TS_ASSERT( surface );
+			xcb_pixmap_t pixmap = xcb->mapBackBuffer[win].pixmap;
+			TS_ASSERT( pixmap );
+			// Small resize keeps the pixmap
+			surface = xcb->get_cairo_surface( win, 110, 55 );
+			TS_ASSERT_EQUALS( xcb->mapBackBuffer[win].pixmap, pixmap );
+			Cairo::RefPtr<Cairo::Context> context = Cairo::Context::create( surface );
+			context->set_source_rgb( 0, 0, 1 );
+			context->paint();
+			surface->flush();
+			xcb->present( win );
+			// Without shared memory exposed parts are copied from the pixmap
+			TS_ASSERT( xcb->present_region( win, 0, 0, 10, 10 ) );
+			// Large resize does not fit
+			surface = xcb->get_cairo_surface( win, 200, 100 );
+			TS_ASSERT_DIFFERS( xcb->mapBackBuffer[win].pixmap, pixmap );
+			xcb->close_window( win );
+			xcb->shm_available = shm_available;
+
+			if (shm_available) {
+				// Frames go through shared memory, so no pixmap is made
+				win = xcb->open_window(100,50);
+				TS_ASSERT( xcb->get_cairo_surface( win, 100, 50 ) );
+				TS_ASSERT_EQUALS( xcb->mapBackBuffer.count( win ), 0 );
+				xcb->close_window( win );
+			}
+		}
+
+		void testXcbPresent() {
+			XcbHandler *xcb = static_cast<XcbHandler*>( XcbHandler::Instance() );
+			size_t win = xcb->open_window(100,50);
+			Cairo::RefPtr<Cairo::ImageSurface> surface = 
+				xcb->get_present_surface( win, 100, 50 );
+			// Empty if the server can't do shared memory, e.g. Xvfb -noshm
+			TS_ASSERT_EQUALS( bool( surface ), xcb->shm_available.load() );
+			if (surface) {
+				TS_ASSERT_EQUALS( surface->get_width(), 100 );
+				TS_ASSERT_EQUALS( surface->get_height(), 50 );
+				Cairo::RefPtr<Cairo::Context> context = Cairo::Context::create( surface );
+				context->set_source_rgb( 1, 0, 0 );
+				context->paint();
+				xcb->present( win );
+				// Exposed part, clipped to the image
+				TS_ASSERT( xcb->present_region( win, 10, 10, 200, 200 ) );
+				// Same size reuses the segment
+				TS_ASSERT_EQUALS( surface, xcb->get_present_surface( win, 100, 50 ) );
+			}
+			xcb->close_window( win );
+			TS_ASSERT( !xcb->present_region( win, 0, 0, 100, 50 ) );
+		}
 };
 	
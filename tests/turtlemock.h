@@ -102,8 +102,9 @@ class MockAdaptiveEventHandler2 : public AdaptiveEventHandler {
 		}
 
 		void add_event(	boost::shared_ptr< Event > 	pEvent, bool 	high_priority = false ) {
-			pEvent->execute( pBPlot );
+			// Same order as process_event, so a replay includes the current event
 			processed_events.push_back( pEvent );
+			pEvent->execute( pBPlot );
 		}
 
 		void reprocess() {